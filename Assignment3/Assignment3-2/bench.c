@@ -0,0 +1,146 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+#include "page_replacement_simulator.h"
+
+/*
+ * bench.c
+ *
+ * Throughput benchmark of the simulate_* functions on synthetic reference
+ * strings (refgen.c). Sizes go up by powers of ten from 10^3 to the
+ * requested maximum, for every workload, frame count and policy.
+ *
+ * Each measurement runs in a forked child, so the peak RSS it reports
+ * (getrusage) belongs to that simulation alone; the child inherits the
+ * generated trace, which is included in the peak. Short runs are repeated
+ * until BENCH_MIN_SECONDS have passed and the rate is averaged.
+ */
+
+#define BENCH_MIN_REFS      1000
+#define BENCH_MIN_SECONDS   0.2
+
+static const int default_frames[] = { 16, 128, 1024 };
+
+/**
+ * BenchSample - What the child sends back through the pipe
+ */
+typedef struct {
+    int faults;
+    int runs;
+    double seconds;     // Total over all runs
+    long rss_before;    // KB, at fork (trace and parent state)
+    long rss_peak;      // KB, after the runs
+} BenchSample;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static long max_rss_kb(void) {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_maxrss;
+}
+
+/**
+ * measure - Runs @fn over @seq in a child process.
+ * Returns -1 if the child could not be started or did not report back.
+ */
+static int measure(SimFn fn, int F, const RefSeq *seq, BenchSample *out) {
+
+    int fd[2];
+    if (pipe(fd) != 0) return -1;
+    fflush(stdout);
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        close(fd[0]);
+        close(fd[1]);
+        return -1;
+    }
+
+    if (pid == 0) {
+        close(fd[0]);
+        BenchSample s = { 0, 0, 0, max_rss_kb(), 0 };
+        do {
+            SimStats st = { 0, 0, NULL };
+            double t0 = now_seconds();
+            s.faults = fn(F, seq, &st);
+            s.seconds += now_seconds() - t0;
+            s.runs++;
+        } while (s.seconds < BENCH_MIN_SECONDS);
+        s.rss_peak = max_rss_kb();
+        ssize_t wr = write(fd[1], &s, sizeof(s));
+        _exit(wr == (ssize_t)sizeof(s) ? 0 : 1);
+    }
+
+    close(fd[1]);
+    ssize_t rd = read(fd[0], out, sizeof(*out));
+    close(fd[0]);
+    int status;
+    waitpid(pid, &status, 0);
+    if (rd != (ssize_t)sizeof(*out) || !WIFEXITED(status) || WEXITSTATUS(status) != 0) return -1;
+    return 0;
+}
+
+/**
+ * run_benchmark - Measures refs/sec and peak RSS of every policy.
+ * Logic:
+ * - One reference string per (workload, size), generated once and shared by
+ *   the frame counts and policies measured on it.
+ * - Frame counts come from @from..@to step @step, or default_frames if @from is 0.
+ */
+int run_benchmark(const char *const *names, const SimFn *fns, int npol, const BenchOptions *o) {
+
+    int frames[1024];
+    int nframes = 0;
+    if (o->from > 0) {
+        for (int F = o->from; F <= o->to && nframes < 1024; F += o->step) frames[nframes++] = F;
+    } else {
+        for (int i = 0; i < (int)(sizeof(default_frames) / sizeof(default_frames[0])); i++)
+            frames[nframes++] = default_frames[i];
+    }
+
+    printf("Benchmark (up to %d refs, %d pages, seed %llu):\n", o->max_refs, o->pages,
+           (unsigned long long)o->seed);
+    printf("%-8s %10s %7s %-8s %10s %6s %10s %12s %10s\n", "Workload", "Refs", "Frames", "Policy",
+           "Faults", "Runs", "Mrefs/s", "PeakRSS(MB)", "Sim(KB)");
+
+    for (int kind = 0; kind < REFGEN_KINDS; kind++) {
+        for (long long n = BENCH_MIN_REFS; ; n *= 10) {
+            if (n > o->max_refs) n = o->max_refs;
+
+            RefSeq seq;
+            if (refgen_generate(&seq, (RefGenKind)kind, (int)n, o->pages, o->seed) != 0) return -1;
+
+            for (int i = 0; i < nframes; i++) {
+                for (int j = 0; j < npol; j++) {
+                    BenchSample s;
+                    if (measure(fns[j], frames[i], &seq, &s) != 0) {
+                        fprintf(stderr, "Benchmark run of %s failed\n", names[j]);
+                        free(seq.refs);
+                        return -1;
+                    }
+                    double rate = s.seconds > 0 ? (double)n * s.runs / s.seconds / 1e6 : 0;
+                    printf("%-8s %10lld %7d %-8s %10d %6d %10.2f %12.1f %10ld\n",
+                           refgen_kind_name((RefGenKind)kind), n, frames[i], names[j], s.faults,
+                           s.runs, rate, s.rss_peak / 1024.0, s.rss_peak - s.rss_before);
+                }
+            }
+            free(seq.refs);
+
+            if (n == o->max_refs) break;
+        }
+    }
+    printf("\n");
+    return 0;
+}
@@ -0,0 +1,306 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "page_replacement_simulator.h"
+
+/*
+ * mrc.c
+ *
+ * LRU miss-ratio curves from reuse (stack) distances.
+ *  - Exact: every reference is processed; the distance of a reference is
+ *    the number of distinct pages touched since the previous access to the
+ *    same page, counted with a Fenwick tree over access times (O(n log D)).
+ *  - SHARDS: only pages whose spatial hash falls under the sampling
+ *    threshold are processed. Distances measured among sampled pages are
+ *    scaled by 1 / rate and the histogram is normalised by the number of
+ *    sampled references. Memory grows with the number of sampled pages only.
+ * A reference hits an LRU cache of c frames iff its distance is below c.
+ * Binary traces are decoded block by block from their mapping, so the trace
+ * itself is never held in memory and its length is not bounded by an int.
+ */
+
+#define HASH_BITS               24
+#define MRC_EXACT_MAX_REFS      100000000   // Longer traces only get the sampled curve
+#define MRC_DEFAULT_MAX_FRAMES  (1 << 20)
+#define MRC_MAX_BLOCK_REFS      (1 << 24)   // Sanity bound on the header's block size
+
+/**
+ * StackDist - Reuse distance tracker
+ * - last: Page -> time index of its latest access.
+ * - bit: Fenwick tree over time indexes, 1 where some page's latest access is.
+ * - Time indexes are renumbered densely when the tree fills up, so its size
+ *   stays proportional to the number of distinct pages.
+ */
+typedef struct {
+    PageMap last;
+    int *bit;
+    int cap;
+    int now;
+    int live;   // Distinct pages seen so far
+} StackDist;
+
+static void bit_add(StackDist *s, int i, int v) {
+    for (i++; i <= s->cap; i += i & -i) s->bit[i] += v;
+}
+
+static int bit_prefix(const StackDist *s, int i) {  // Marks at time indexes 0..i-1
+    int sum = 0;
+    for (; i > 0; i -= i & -i) sum += s->bit[i];
+    return sum;
+}
+
+/**
+ * bit_rebuild - Builds the tree with marks at 0..live-1 in linear time.
+ */
+static void bit_rebuild(StackDist *s, int cap) {
+    free(s->bit);
+    s->cap = cap;
+    s->bit = (int*)calloc(cap + 1, sizeof(int));
+    for (int i = 1; i <= cap; i++) {
+        if (i <= s->live) s->bit[i]++;
+        int j = i + (i & -i);
+        if (j <= cap) s->bit[j] += s->bit[i];
+    }
+}
+
+static void sd_init(StackDist *s) {
+    pagemap_init(&s->last, 1024);
+    s->bit = NULL;
+    s->now = s->live = 0;
+    bit_rebuild(s, 1024);
+}
+
+static void sd_free(StackDist *s) {
+    pagemap_free(&s->last);
+    free(s->bit);
+}
+
+typedef struct {
+    int time;
+    int slot;   // Slot of the page in StackDist.last
+} TimeSlot;
+
+static int cmp_time(const void *a, const void *b) {
+    return ((const TimeSlot*)a)->time - ((const TimeSlot*)b)->time;
+}
+
+/**
+ * sd_compact - Renumbers the latest access times to 0..live-1 (order kept).
+ */
+static void sd_compact(StackDist *s) {
+    TimeSlot *ts = (TimeSlot*)malloc(sizeof(TimeSlot)*(s->live ? s->live : 1));
+    int k = 0;
+    for (int i = 0; i < s->last.cap; i++) {
+        if (s->last.keys[i] != -1) {
+            ts[k].time = s->last.vals[i];
+            ts[k++].slot = i;
+        }
+    }
+
+    qsort(ts, k, sizeof(TimeSlot), cmp_time);
+    for (int i = 0; i < k; i++) s->last.vals[ts[i].slot] = i;
+    free(ts);
+
+    s->now = s->live;
+    int cap = 1024;
+    while (cap < s->live * 2) cap *= 2;
+    bit_rebuild(s, cap);
+}
+
+/**
+ * sd_access - Records an access.
+ * Returns the reuse distance, or -1 for the first access to the page.
+ */
+static int sd_access(StackDist *s, int page) {
+
+    if (s->now == s->cap) sd_compact(s);
+
+    int *lt = pagemap_put(&s->last, page, -1);
+    int d = -1;
+    if (*lt >= 0) {
+        d = s->live - bit_prefix(s, *lt + 1);
+        bit_add(s, *lt, -1);
+    } else {
+        s->live++;
+    }
+    *lt = s->now;
+    bit_add(s, s->now++, 1);
+    return d;
+}
+
+static uint64_t mix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+static double elapsed(const struct timespec *a) {
+    struct timespec b;
+    clock_gettime(CLOCK_MONOTONIC, &b);
+    return (b.tv_sec - a->tv_sec) + (b.tv_nsec - a->tv_nsec) / 1e9;
+}
+
+/**
+ * build_mrc - Reuse distance histogram of a binary trace, streamed block by block.
+ * @rate  : Sampling rate (1.0 = exact)
+ * @hist  : hist[d] = references with distance d, for d < @maxd;
+ *          hist[maxd] collects the cold misses and every larger distance
+ * @pages : Estimated number of distinct pages
+ * @nrefs : References in the trace
+ * Returns the number of references processed, -1 if the trace can't be read.
+ */
+static long long build_mrc(const char *path, double rate, double *hist, int maxd,
+                           double *pages, long long *nrefs) {
+
+    TraceReader r;
+    if (trace_reader_open(&r, path) != 0) return -1;
+    if (r.block_refs <= 0 || r.block_refs > MRC_MAX_BLOCK_REFS) {
+        trace_reader_close(&r);
+        fprintf(stderr, "Wrong trace header\n");
+        return -1;
+    }
+
+    uint64_t threshold = (uint64_t)(rate * (1ull << HASH_BITS));
+    bool exact = (rate >= 1.0);
+    int *block = (int*)malloc(sizeof(int)*r.block_refs);
+    StackDist sd;
+    sd_init(&sd);
+
+    long long sampled = 0;
+    *nrefs = 0;
+    memset(hist, 0, sizeof(double)*(maxd + 1));
+
+    int got;
+    while ((got = trace_reader_next(&r, block, NULL, r.block_refs)) > 0) {
+        *nrefs += got;
+        for (int t = 0; t < got; t++) {
+            int p = block[t];
+            if (!exact && (mix64((uint64_t)p) & ((1ull << HASH_BITS) - 1)) >= threshold) continue;
+
+            sampled++;
+            int d = sd_access(&sd, p);
+            double scaled = (d < 0) ? -1 : (exact ? d : d / rate);
+            if (scaled < 0 || scaled >= maxd) hist[maxd] += 1;
+            else hist[(int)scaled] += 1;
+        }
+    }
+    if (got == 0 && (uint64_t)*nrefs != r.nrefs) {
+        fprintf(stderr, "Truncated trace: %lld of %llu refs\n", *nrefs, (unsigned long long)r.nrefs);
+        got = -1;
+    }
+
+    // Scale the sampled counts up to the whole trace
+    if (!exact && sampled > 0)
+        for (int d = 0; d <= maxd; d++) hist[d] *= (double)*nrefs / sampled;
+    *pages = exact ? sd.live : sd.live / rate;
+
+    sd_free(&sd);
+    free(block);
+    trace_reader_close(&r);
+    return got < 0 ? -1 : sampled;
+}
+
+/**
+ * miss_ratio - Fraction of references that miss an LRU cache of @c frames.
+ * Uses the suffix sums in @tail (tail[c] = references with distance >= c).
+ */
+static double miss_ratio(const double *tail, int c, long long n) {
+    double r = n ? tail[c] / n : 0;
+    if (r < 0) r = 0;
+    if (r > 1) r = 1;
+    return r;
+}
+
+int run_mrc_study(const char *path, double rate, int from, int to, int step) {
+
+    // Text inputs would have to be loaded whole; they are converted once with -C instead
+    FILE *fp = fopen(path, "r");
+    if (fp != NULL) {
+        int binary = trace_is_binary(fp);
+        fclose(fp);
+        if (!binary) {
+            fprintf(stderr, "%s is not a binary trace (convert it with -C)\n", path);
+            return -1;
+        }
+    }
+
+    // Cache sizes: the given range, or powers of two
+    if (from <= 0) {
+        from = 1;
+        to = MRC_DEFAULT_MAX_FRAMES;
+        step = 0;
+    }
+    int maxd = to + 1;
+
+    double *hist = (double*)malloc(sizeof(double)*(maxd + 1));
+    double *tail_s = (double*)malloc(sizeof(double)*(maxd + 2));
+    double *tail_e = NULL;
+    double pages_s, pages_e = 0;
+    long long n;
+    struct timespec t0;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    long long sampled = build_mrc(path, rate, hist, maxd, &pages_s, &n);
+    double time_s = elapsed(&t0);
+    if (sampled < 0) {
+        free(hist);
+        free(tail_s);
+        return -1;
+    }
+    tail_s[maxd + 1] = 0;
+    for (int d = maxd; d >= 0; d--) tail_s[d] = tail_s[d + 1] + hist[d];
+
+    // Second pass over the mapping for the exact curve
+    bool exact = n <= MRC_EXACT_MAX_REFS;
+    double time_e = 0;
+    if (exact) {
+        tail_e = (double*)malloc(sizeof(double)*(maxd + 2));
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        build_mrc(path, 1.0, hist, maxd, &pages_e, &n);
+        time_e = elapsed(&t0);
+        tail_e[maxd + 1] = 0;
+        for (int d = maxd; d >= 0; d--) tail_e[d] = tail_e[d + 1] + hist[d];
+    }
+
+    printf("Miss Ratio Curve (LRU, SHARDS rate %.2f%%, %lld of %lld refs sampled, ~%.0f pages):\n",
+           rate * 100, sampled, n, pages_s);
+    printf("%8s %10s %10s %10s\n", "Frames", "Exact", "SHARDS", "Error");
+
+    double err_sum = 0, err_max = 0;
+    int points = 0;
+    double pages = exact ? pages_e : pages_s;
+    for (long long c = from; c <= to; c = step ? c + step : c * 2) {
+        double ms = miss_ratio(tail_s, (int)c, n);
+        if (exact) {
+            double me = miss_ratio(tail_e, (int)c, n);
+            double err = ms > me ? ms - me : me - ms;
+            err_sum += err;
+            if (err > err_max) err_max = err;
+            printf("%8lld %9.2f%% %9.2f%% %9.2f%%\n", c, me * 100, ms * 100, err * 100);
+        } else {
+            printf("%8lld %10s %9.2f%% %10s\n", c, "-", ms * 100, "-");
+        }
+        points++;
+        // Past the footprint the curve is flat
+        if (!step && c >= 2 * pages) break;
+    }
+
+    if (exact && points)
+        printf("Mean Absolute Error: %.2f%%, Max Error: %.2f%%\n", err_sum / points * 100, err_max * 100);
+    printf("Time: SHARDS %.3f s", time_s);
+    if (exact) printf(", exact %.3f s", time_e);
+    printf("\n\n");
+
+    free(hist);
+    free(tail_s);
+    free(tail_e);
+    return 0;
+}
@@ -0,0 +1,376 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "page_replacement_simulator.h"
+
+/*
+ * multiprocess.c
+ *
+ * Several processes share one physical frame pool, each with its own
+ * reference stream. The streams are merged into a single interleaved trace
+ * (by timestamp or by a round-robin scheduler) and replayed with LRU under
+ * - Global replacement: the victim is the least recently used frame of the whole pool.
+ * - Local replacement : each process only replaces its own frames (fixed quota).
+ */
+
+#define THRASH_FAULT_RATE 0.5   // A window with a higher fault rate counts as thrashing
+
+/**
+ * MultiResult - Per-process and system-wide statistics of one run
+ */
+typedef struct {
+    int *refs;          // References issued by each process
+    int *faults;        // Faults of each process
+    int *stolen;        // Pages of each process evicted by another process
+    int *thrash;        // Windows in which each process was thrashing
+    int sys_faults;
+    int sys_thrash;     // Windows in which the whole system was thrashing
+    int windows;        // Number of complete windows
+} MultiResult;
+
+typedef struct {
+    long time;
+    int seq;    // Position in the file (keeps the sort stable)
+    int pid;
+    int page;
+} TimedRef;
+
+static void free_trace(MultiTrace *mt) {
+    free(mt->pid);
+    free(mt->page);
+    free(mt->ids);
+    free(mt->quota);
+}
+
+static int cmp_timed(const void *a, const void *b) {
+    const TimedRef *x = a, *y = b;
+    if (x->time != y->time) return x->time < y->time ? -1 : 1;
+    return x->seq - y->seq;
+}
+
+/**
+ * read_timed_trace - Reads "<time> <pid> <page>" records and orders them by time.
+ * The pool is split evenly between the processes for local replacement.
+ */
+static int read_timed_trace(const char *path, MultiTrace *mt) {
+
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL) {
+        fprintf(stderr, "Can't open %s\n", path);
+        return -1;
+    }
+
+    if (fscanf(fp, "%d", &mt->pool) != 1 || mt->pool <= 0 || mt->pool > MAX_FRAMES) {
+        fclose(fp);
+        fprintf(stderr, "Wrong input\n");
+        return -1;
+    }
+
+    int cap = 128;
+    int n = 0;
+    bool sorted = true;
+    TimedRef *recs = (TimedRef*)malloc(sizeof(TimedRef)*cap);
+
+    // Map arbitrary pids to dense indexes in order of first appearance
+    PageMap pidmap;
+    pagemap_init(&pidmap, 16);
+    int nproc = 0;
+    int id_cap = 16;
+    int *ids = (int*)malloc(sizeof(int)*id_cap);
+
+    TimedRef r;
+    while (fscanf(fp, "%ld %d %d", &r.time, &r.pid, &r.page) == 3) {
+        if (r.pid < 0 || r.page < 0) {
+            fprintf(stderr, "Wrong input\n");
+            fclose(fp);
+            free(recs);
+            free(ids);
+            pagemap_free(&pidmap);
+            return -1;
+        }
+        int *idx = pagemap_put(&pidmap, r.pid, -1);
+        if (*idx < 0) {
+            if (nproc == id_cap) {
+                id_cap *= 2;
+                ids = (int*)realloc(ids, sizeof(int)*id_cap);
+            }
+            ids[nproc] = r.pid;
+            *idx = nproc++;
+        }
+        r.pid = *idx;
+        r.seq = n;
+
+        if (n == cap) {
+            cap *= 2;
+            recs = (TimedRef*)realloc(recs, sizeof(TimedRef)*cap);
+        }
+        if (n > 0 && r.time < recs[n-1].time) sorted = false;
+        recs[n++] = r;
+    }
+    fclose(fp);
+    pagemap_free(&pidmap);
+
+    if (nproc == 0 || mt->pool < nproc) {
+        fprintf(stderr, "Wrong input\n");
+        free(recs);
+        free(ids);
+        return -1;
+    }
+
+    if (!sorted) qsort(recs, n, sizeof(TimedRef), cmp_timed);
+
+    mt->nproc = nproc;
+    mt->n = n;
+    mt->ids = ids;
+    mt->pid = (int*)malloc(sizeof(int)*n);
+    mt->page = (int*)malloc(sizeof(int)*n);
+    for (int k = 0; k < n; k++) {
+        mt->pid[k] = recs[k].pid;
+        mt->page[k] = recs[k].page;
+    }
+    free(recs);
+
+    // Even split of the pool (the first processes take the remainder)
+    mt->quota = (int*)malloc(sizeof(int)*nproc);
+    for (int p = 0; p < nproc; p++)
+        mt->quota[p] = mt->pool / nproc + (p < mt->pool % nproc);
+
+    return 0;
+}
+
+/**
+ * build_rr_trace - Interleaves per-process input files with a round-robin scheduler.
+ * Each process runs for @quantum references before the next one is scheduled.
+ */
+static int build_rr_trace(char **paths, int nproc, int quantum, MultiTrace *mt) {
+
+    RefSeq *seqs = (RefSeq*)calloc(nproc, sizeof(RefSeq));
+    mt->nproc = nproc;
+    mt->n = 0;
+    mt->pool = 0;
+    mt->ids = (int*)malloc(sizeof(int)*nproc);
+    mt->quota = (int*)malloc(sizeof(int)*nproc);
+
+    for (int p = 0; p < nproc; p++) {
+        if (read_input(paths[p], &mt->quota[p], &seqs[p]) != 0) {
+            for (int q = 0; q < p; q++) {
+                free(seqs[q].refs);
+                free(seqs[q].write);
+            }
+            free(seqs);
+            free(mt->ids);
+            free(mt->quota);
+            return -1;
+        }
+        mt->ids[p] = p;
+        mt->pool += mt->quota[p];
+        mt->n += seqs[p].n;
+    }
+
+    mt->pid = (int*)malloc(sizeof(int)*(mt->n ? mt->n : 1));
+    mt->page = (int*)malloc(sizeof(int)*(mt->n ? mt->n : 1));
+
+    int *pos = (int*)calloc(nproc, sizeof(int));
+    int k = 0;
+    while (k < mt->n) {
+        for (int p = 0; p < nproc; p++) {
+            for (int q = 0; q < quantum && pos[p] < seqs[p].n; q++) {
+                mt->pid[k] = p;
+                mt->page[k++] = seqs[p].refs[pos[p]++];
+            }
+        }
+    }
+
+    for (int p = 0; p < nproc; p++) {
+        free(seqs[p].refs);
+        free(seqs[p].write);
+    }
+    free(seqs);
+    free(pos);
+    return 0;
+}
+
+/**
+ * simulate_multi_lru - LRU over a shared frame pool
+ * Logic:
+ * - maps[p]: Page -> frame index of process p (-1 once evicted).
+ * - Frames are kept in LRU lists (prev/next, most recent at head).
+ *   Global replacement uses a single list, local replacement one list per process.
+ * - MISS:
+ * (1) Global: use a free frame, otherwise evict the pool-wide LRU frame (any owner).
+ * (2) Local : use a free frame while under quota, otherwise evict the own LRU frame.
+ * - Every @window references the fault rate of the window is checked for thrashing.
+ */
+static void simulate_multi_lru(const MultiTrace *mt, bool global, int window, MultiResult *res) {
+
+    int F = mt->pool;
+    int np = mt->nproc;
+    int nlists = global ? 1 : np;
+
+    int *owner = (int*)malloc(sizeof(int)*F);
+    int *fpage = (int*)malloc(sizeof(int)*F);
+    int *prev  = (int*)malloc(sizeof(int)*F);
+    int *next  = (int*)malloc(sizeof(int)*F);
+    int *head  = (int*)malloc(sizeof(int)*nlists);
+    int *tail  = (int*)malloc(sizeof(int)*nlists);
+    for (int l = 0; l < nlists; l++) head[l] = tail[l] = -1;
+
+    int *resident = (int*)calloc(np, sizeof(int));
+    int *wp_refs   = (int*)calloc(np, sizeof(int));
+    int *wp_faults = (int*)calloc(np, sizeof(int));
+    PageMap *maps = (PageMap*)malloc(sizeof(PageMap)*np);
+    for (int p = 0; p < np; p++) pagemap_init(&maps[p], 64);
+
+    memset(res, 0, sizeof(*res));
+    res->refs   = (int*)calloc(np, sizeof(int));
+    res->faults = (int*)calloc(np, sizeof(int));
+    res->stolen = (int*)calloc(np, sizeof(int));
+    res->thrash = (int*)calloc(np, sizeof(int));
+
+    int filled = 0;
+    int win_refs = 0, win_faults = 0;
+
+    for (int k = 0; k < mt->n; k++) {
+
+        int p = mt->pid[k];
+        int pg = mt->page[k];
+        int l = global ? 0 : p;
+        int *fr = pagemap_put(&maps[p], pg, -1);
+
+        res->refs[p]++;
+        wp_refs[p]++;
+        win_refs++;
+
+        int f = *fr;
+        if (f >= 0) {
+            // HIT: unlink the frame so it can be moved to the head
+            if (prev[f] != -1) next[prev[f]] = next[f]; else head[l] = next[f];
+            if (next[f] != -1) prev[next[f]] = prev[f]; else tail[l] = prev[f];
+        } else {
+            // MISS
+            res->faults[p]++;
+            res->sys_faults++;
+            wp_faults[p]++;
+            win_faults++;
+
+            if (global ? filled < F : resident[p] < mt->quota[p]) {
+                f = filled++;
+            } else {
+                // Evict the LRU frame of the list (tail)
+                f = tail[l];
+                tail[l] = prev[f];
+                if (tail[l] != -1) next[tail[l]] = -1; else head[l] = -1;
+
+                int q = owner[f];
+                *pagemap_get(&maps[q], fpage[f]) = -1;
+                resident[q]--;
+                if (q != p) res->stolen[q]++;
+            }
+            owner[f] = p;
+            fpage[f] = pg;
+            *fr = f;
+            resident[p]++;
+        }
+
+        // Insert at the head (most recently used)
+        prev[f] = -1;
+        next[f] = head[l];
+        if (head[l] != -1) prev[head[l]] = f; else tail[l] = f;
+        head[l] = f;
+
+        // Thrashing detection at the end of each window
+        if (win_refs == window) {
+            res->windows++;
+            if (win_faults > THRASH_FAULT_RATE * window) res->sys_thrash++;
+            for (int q = 0; q < np; q++) {
+                if (wp_refs[q] > 0 && wp_faults[q] > THRASH_FAULT_RATE * wp_refs[q])
+                    res->thrash[q]++;
+                wp_refs[q] = wp_faults[q] = 0;
+            }
+            win_refs = win_faults = 0;
+        }
+    }
+
+    for (int p = 0; p < np; p++) pagemap_free(&maps[p]);
+    free(maps);
+    free(owner);
+    free(fpage);
+    free(prev);
+    free(next);
+    free(head);
+    free(tail);
+    free(resident);
+    free(wp_refs);
+    free(wp_faults);
+}
+
+/**
+ * print_multi_result - Displays per-process and system-wide results of one run.
+ */
+static void print_multi_result(const char *title, const MultiTrace *mt, bool global,
+                               const MultiResult *res, int window) {
+
+    printf("%s (pool: %d frames)\n", title, mt->pool);
+    for (int p = 0; p < mt->nproc; p++) {
+        double rate = res->refs[p] ? (res->faults[p] * 100.0) / res->refs[p] : 0;
+        printf("Process %d: ", mt->ids[p]);
+        if (!global) printf("quota %d frames, ", mt->quota[p]);
+        printf("%d refs, %d faults (%.2f%%), %d pages evicted by other processes, "
+               "thrashing in %d windows\n",
+               res->refs[p], res->faults[p], rate, res->stolen[p], res->thrash[p]);
+    }
+
+    double rate = mt->n ? (res->sys_faults * 100.0) / mt->n : 0;
+    printf("System Page Faults: %d\n", res->sys_faults);
+    printf("System Page Fault Rate: %.2f%%\n", rate);
+    printf("Thrashing: %d of %d windows (window=%d refs, fault rate > %.0f%%)\n\n",
+           res->sys_thrash, res->windows, window, THRASH_FAULT_RATE * 100);
+}
+
+static void free_result(MultiResult *res) {
+    free(res->refs);
+    free(res->faults);
+    free(res->stolen);
+    free(res->thrash);
+}
+
+/**
+ * compare_allocation - Runs the merged trace under global and local replacement.
+ */
+static void compare_allocation(const MultiTrace *mt, int window) {
+
+    MultiResult res;
+
+    simulate_multi_lru(mt, true, window, &res);
+    print_multi_result("Global LRU Replacement", mt, true, &res, window);
+    free_result(&res);
+
+    simulate_multi_lru(mt, false, window, &res);
+    print_multi_result("Local LRU Replacement", mt, false, &res, window);
+    free_result(&res);
+}
+
+int run_multiprocess_trace(const char *path, int window, const NumaConfig *numa) {
+
+    MultiTrace mt;
+    if (read_timed_trace(path, &mt) != 0) return -1;
+
+    compare_allocation(&mt, window);
+    int ret = numa ? run_numa_model(&mt, numa) : 0;
+    free_trace(&mt);
+    return ret;
+}
+
+int run_multiprocess_rr(char **paths, int nproc, int quantum, int window, const NumaConfig *numa) {
+
+    MultiTrace mt;
+    if (build_rr_trace(paths, nproc, quantum, &mt) != 0) return -1;
+
+    compare_allocation(&mt, window);
+    int ret = numa ? run_numa_model(&mt, numa) : 0;
+    free_trace(&mt);
+    return ret;
+}
@@ -0,0 +1,294 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "page_replacement_simulator.h"
+
+/*
+ * numa.c
+ *
+ * The shared frame pool of a multi-process trace split into NUMA nodes.
+ * Each node has its own frames and its own LRU list; process p's home node
+ * is p % nodes. A reference costs the local or the remote latency depending
+ * on where its frame is, and faults are counted as in multiprocess.c.
+ *
+ * Placement on a fault:
+ *  - Local only  : always the home node, reclaiming its LRU frame when full.
+ *  - Local-first : the home node while it has free frames, then the next node
+ *                  (in node order) with a free frame; reclaims at home once
+ *                  every node is full.
+ *  - Interleave  : the process's allocations rotate over the nodes.
+ * Migration (optional): a page that has been accessed remotely migrate_after
+ * times since it was placed moves to the accessing process's home node,
+ * at the cost of NUMA_MIGRATE_NS.
+ */
+
+#define NUMA_MAX_NODES      64
+#define NUMA_MIGRATE_NS     2000    // Copying one 4 KB page plus the remap
+
+typedef enum { PLACE_LOCAL, PLACE_FALLBACK, PLACE_INTERLEAVE } Placement;
+
+static const char *placement_names[] = { "Local only", "Local-first", "Interleave" };
+
+/**
+ * NumaResult - Totals of one placement run
+ */
+typedef struct {
+    long long faults;
+    long long local;        // References served from the home node
+    long long remote;       // References served from another node
+    long long fallbacks;    // Faults placed away from the home node
+    long long migrations;
+} NumaResult;
+
+/**
+ * NumaPool - Frames split into per-node ranges
+ * - base[n] .. base[n+1]-1: Frames of node n.
+ * - freef[base[n] .. base[n]+nfree[n]-1]: Free-frame stack of node n.
+ * - prev/next/head/tail: One LRU list per node (most recent at head).
+ * - rhits[f]: Remote accesses to frame f since its page was placed there.
+ */
+typedef struct {
+    int nodes;
+    int *base;
+    int *nfree;
+    int *freef;
+    int *node_of;
+    int *owner;
+    int *fpage;
+    int *prev;
+    int *next;
+    int *head;
+    int *tail;
+    int *rhits;
+    PageMap *maps;  // Per process: page -> frame (-1 once evicted)
+    int np;
+} NumaPool;
+
+int numa_parse_config(const char *spec, NumaConfig *cfg) {
+
+    cfg->local_ns = 80;
+    cfg->remote_ns = 140;
+    cfg->migrate_after = 8;
+
+    int n = sscanf(spec, "%d:%d:%d:%d", &cfg->nodes, &cfg->local_ns, &cfg->remote_ns,
+                   &cfg->migrate_after);
+    if (n != 1 && n != 3 && n != 4) return -1;
+
+    if (cfg->nodes < 2 || cfg->nodes > NUMA_MAX_NODES || cfg->local_ns <= 0 ||
+        cfg->remote_ns < cfg->local_ns || cfg->migrate_after < 0)
+        return -1;
+    return 0;
+}
+
+static void pool_init(NumaPool *np, const MultiTrace *mt, int nodes) {
+
+    int F = mt->pool;
+    np->nodes = nodes;
+    np->np = mt->nproc;
+    np->base    = (int*)malloc(sizeof(int)*(nodes + 1));
+    np->nfree   = (int*)malloc(sizeof(int)*nodes);
+    np->head    = (int*)malloc(sizeof(int)*nodes);
+    np->tail    = (int*)malloc(sizeof(int)*nodes);
+    np->freef   = (int*)malloc(sizeof(int)*F);
+    np->node_of = (int*)malloc(sizeof(int)*F);
+    np->owner   = (int*)malloc(sizeof(int)*F);
+    np->fpage   = (int*)malloc(sizeof(int)*F);
+    np->prev    = (int*)malloc(sizeof(int)*F);
+    np->next    = (int*)malloc(sizeof(int)*F);
+    np->rhits   = (int*)calloc(F, sizeof(int));
+
+    // Even split of the pool (the first nodes take the remainder)
+    np->base[0] = 0;
+    for (int n = 0; n < nodes; n++) {
+        int size = F / nodes + (n < F % nodes);
+        np->base[n + 1] = np->base[n] + size;
+        np->nfree[n] = size;
+        np->head[n] = np->tail[n] = -1;
+        for (int i = 0; i < size; i++) {
+            int f = np->base[n] + i;
+            np->node_of[f] = n;
+            np->freef[np->base[n] + i] = np->base[n + 1] - 1 - i;  // Lowest frame on top
+        }
+    }
+
+    np->maps = (PageMap*)malloc(sizeof(PageMap)*mt->nproc);
+    for (int p = 0; p < mt->nproc; p++) pagemap_init(&np->maps[p], 64);
+}
+
+static void pool_free(NumaPool *np) {
+    for (int p = 0; p < np->np; p++) pagemap_free(&np->maps[p]);
+    free(np->maps);
+    free(np->base);
+    free(np->nfree);
+    free(np->head);
+    free(np->tail);
+    free(np->freef);
+    free(np->node_of);
+    free(np->owner);
+    free(np->fpage);
+    free(np->prev);
+    free(np->next);
+    free(np->rhits);
+}
+
+static void lru_unlink(NumaPool *np, int f) {
+    int n = np->node_of[f];
+    if (np->prev[f] != -1) np->next[np->prev[f]] = np->next[f]; else np->head[n] = np->next[f];
+    if (np->next[f] != -1) np->prev[np->next[f]] = np->prev[f]; else np->tail[n] = np->prev[f];
+}
+
+static void lru_push(NumaPool *np, int f) {
+    int n = np->node_of[f];
+    np->prev[f] = -1;
+    np->next[f] = np->head[n];
+    if (np->head[n] != -1) np->prev[np->head[n]] = f; else np->tail[n] = f;
+    np->head[n] = f;
+}
+
+/**
+ * alloc_frame - Takes a frame on node @n: a free one, otherwise the node's
+ * LRU frame, whose page is evicted from its owner's map.
+ */
+static int alloc_frame(NumaPool *np, int n) {
+
+    if (np->nfree[n] > 0)
+        return np->freef[np->base[n] + --np->nfree[n]];
+
+    int f = np->tail[n];
+    lru_unlink(np, f);
+    *pagemap_get(&np->maps[np->owner[f]], np->fpage[f]) = -1;
+    return f;
+}
+
+static void release_frame(NumaPool *np, int f) {
+    int n = np->node_of[f];
+    np->freef[np->base[n] + np->nfree[n]++] = f;
+}
+
+/**
+ * pick_node - Node a faulting page of a process with home node @home goes to.
+ */
+static int pick_node(const NumaPool *np, Placement place, int home, int *rr) {
+
+    if (place == PLACE_INTERLEAVE) {
+        int n = *rr;
+        *rr = (n + 1) % np->nodes;
+        return n;
+    }
+    if (place == PLACE_FALLBACK && np->nfree[home] == 0) {
+        for (int i = 1; i < np->nodes; i++) {
+            int n = (home + i) % np->nodes;
+            if (np->nfree[n] > 0) return n;
+        }
+    }
+    return home;
+}
+
+/**
+ * simulate_numa - Replays the merged trace over the node-split pool.
+ * Logic:
+ * - HIT: charge local or remote latency; a remote hit counts towards
+ *   migration, which moves the page to a frame on the home node.
+ * - MISS: place the page with the placement policy, then charge the access
+ *   at the latency of the chosen node.
+ */
+static void simulate_numa(const MultiTrace *mt, const NumaConfig *cfg, Placement place,
+                          bool migrate, NumaResult *res) {
+
+    NumaPool np;
+    pool_init(&np, mt, cfg->nodes);
+    int *rr = (int*)calloc(mt->nproc, sizeof(int));
+    for (int p = 0; p < mt->nproc; p++) rr[p] = p % cfg->nodes;
+    memset(res, 0, sizeof(*res));
+
+    for (int k = 0; k < mt->n; k++) {
+
+        int p = mt->pid[k];
+        int pg = mt->page[k];
+        int home = p % cfg->nodes;
+        int f = *pagemap_put(&np.maps[p], pg, -1);
+
+        if (f >= 0) {
+            lru_unlink(&np, f);
+        } else {
+            res->faults++;
+            int n = pick_node(&np, place, home, &rr[p]);
+            if (place != PLACE_INTERLEAVE && n != home) res->fallbacks++;
+            f = alloc_frame(&np, n);
+            np.owner[f] = p;
+            np.fpage[f] = pg;
+            np.rhits[f] = 0;
+            *pagemap_get(&np.maps[p], pg) = f;
+        }
+
+        if (np.node_of[f] == home) res->local++;
+        else {
+            res->remote++;
+            if (migrate && ++np.rhits[f] >= cfg->migrate_after) {
+                // Move the page home; reclaiming there may evict another page
+                int g = alloc_frame(&np, home);
+                np.owner[g] = p;
+                np.fpage[g] = pg;
+                np.rhits[g] = 0;
+                *pagemap_get(&np.maps[p], pg) = g;
+                release_frame(&np, f);
+                f = g;
+                res->migrations++;
+            }
+        }
+        lru_push(&np, f);
+    }
+
+    free(rr);
+    pool_free(&np);
+}
+
+static void print_numa_row(const char *name, const NumaResult *res, const NumaConfig *cfg, int n) {
+
+    long long refs = res->local + res->remote;
+    double remote = refs ? (double)res->remote / refs : 0;
+    double lat = refs ? ((double)res->local * cfg->local_ns + (double)res->remote * cfg->remote_ns +
+                         (double)res->migrations * NUMA_MIGRATE_NS) / refs : 0;
+    printf("%-24s %10lld %8.2f%% %9.2f%% %10lld %11lld %12.1f\n", name, res->faults,
+           n ? res->faults * 100.0 / n : 0, remote * 100, res->fallbacks, res->migrations, lat);
+}
+
+/**
+ * run_numa_model - Compares the placement policies with and without migration.
+ * Logic:
+ * - Average latency = (local refs x local + remote refs x remote +
+ *   migrations x NUMA_MIGRATE_NS) / refs; fault service time is not included.
+ */
+int run_numa_model(const MultiTrace *mt, const NumaConfig *cfg) {
+
+    if (mt->pool < cfg->nodes) {
+        fprintf(stderr, "Wrong input\n");
+        return -1;
+    }
+
+    printf("NUMA Model (%d nodes, %d frames, local %d ns, remote %d ns", cfg->nodes, mt->pool,
+           cfg->local_ns, cfg->remote_ns);
+    if (cfg->migrate_after > 0) printf(", migrate after %d remote refs", cfg->migrate_after);
+    printf("):\n");
+    printf("%-24s %10s %9s %10s %10s %11s %12s\n", "Placement", "Faults", "FaultRate",
+           "Remote", "Fallbacks", "Migrations", "AvgLat(ns)");
+
+    NumaResult res;
+    char name[64];
+    for (int pl = PLACE_LOCAL; pl <= PLACE_INTERLEAVE; pl++) {
+        simulate_numa(mt, cfg, (Placement)pl, false, &res);
+        print_numa_row(placement_names[pl], &res, cfg, mt->n);
+    }
+    if (cfg->migrate_after > 0) {
+        for (int pl = PLACE_FALLBACK; pl <= PLACE_INTERLEAVE; pl++) {
+            simulate_numa(mt, cfg, (Placement)pl, true, &res);
+            snprintf(name, sizeof(name), "%s + migration", placement_names[pl]);
+            print_numa_row(name, &res, cfg, mt->n);
+        }
+    }
+    printf("\n");
+    return 0;
+}
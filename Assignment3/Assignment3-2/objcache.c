@@ -0,0 +1,394 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "page_replacement_simulator.h"
+
+/*
+ * objcache.c
+ *
+ * Object-cache variant of the simulator: every reference names an object
+ * and its size in bytes, and the cache capacity is a byte budget. Objects
+ * are indexed with a PageMap (object -> slot), so a lookup is O(1) as for
+ * the page policies; eviction order is kept per policy:
+ *  - LRU          : least recently used object (size-unaware baseline).
+ *  - LRU-2        : oldest second-to-last reference (backward 2-distance);
+ *                   objects referenced only once go first, in LRU order.
+ *                   The last reference time of evicted objects is kept as
+ *                   history, so a returning object is not treated as new.
+ *  - GDSF         : GreedyDual-Size-Frequency, priority L + freq / size,
+ *                   where L is raised to the priority of every victim.
+ *  - Size-adj LRU : objects in LRU lists per power-of-two size class; the
+ *                   victim is the class tail with the largest size x age.
+ * An object larger than the whole cache is never stored (bypassed).
+ */
+
+#define SIZE_CLASSES 32
+
+typedef enum { OBJ_LRU, OBJ_LRU2, OBJ_GDSF, OBJ_SIZE_LRU } ObjPolicy;
+
+static const char *obj_policy_names[] = { "LRU", "LRU-2", "GDSF", "Size-adj LRU" };
+
+/**
+ * ObjTrace - Object references read from the input
+ */
+typedef struct {
+    long long capacity;     // Bytes
+    int n;
+    int *key;
+    int *size;
+} ObjTrace;
+
+/**
+ * ObjCache - Cached objects of one run
+ * - map: Object -> slot (-1 once evicted).
+ * - heap/pos: Indexed min-heap of slots ordered by prio, then by last
+ *   reference (LRU, LRU-2 and GDSF).
+ * - prev/next/head/tail: LRU list per size class (size-adjusted LRU).
+ * - hist: Object -> last reference time, also after eviction (LRU-2).
+ */
+typedef struct {
+    ObjPolicy policy;
+    long long capacity;
+    long long used;
+    int cap;                // Slots allocated
+    int slots;              // Slots handed out so far
+    int count;              // Objects cached (heap size)
+    int *key, *size, *freq, *last, *heap, *pos, *prev, *next, *free_slots;
+    double *prio;
+    int nfree;
+    int head[SIZE_CLASSES], tail[SIZE_CLASSES];
+    double L;               // GDSF inflation value
+    PageMap map;
+    PageMap hist;
+} ObjCache;
+
+/**
+ * ObjResult - Totals of one run
+ */
+typedef struct {
+    long long hits;
+    long long hit_bytes;
+    long long req_bytes;
+    long long evictions;
+    long long bypassed;
+} ObjResult;
+
+/**
+ * read_obj_trace - Reads the capacity in bytes followed by "<object> <size>" records.
+ */
+static int read_obj_trace(const char *path, ObjTrace *tr) {
+
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL) {
+        fprintf(stderr, "Can't open %s\n", path);
+        return -1;
+    }
+
+    if (fscanf(fp, "%lld", &tr->capacity) != 1 || tr->capacity <= 0) {
+        fclose(fp);
+        fprintf(stderr, "Wrong input\n");
+        return -1;
+    }
+
+    int cap = 128;
+    tr->n = 0;
+    tr->key = (int*)malloc(sizeof(int)*cap);
+    tr->size = (int*)malloc(sizeof(int)*cap);
+
+    int k, sz;
+    while (fscanf(fp, "%d %d", &k, &sz) == 2) {
+        if (k < 0 || sz <= 0) {
+            fprintf(stderr, "Wrong input\n");
+            fclose(fp);
+            free(tr->key);
+            free(tr->size);
+            return -1;
+        }
+        if (tr->n == cap) {
+            cap *= 2;
+            tr->key = (int*)realloc(tr->key, sizeof(int)*cap);
+            tr->size = (int*)realloc(tr->size, sizeof(int)*cap);
+        }
+        tr->key[tr->n] = k;
+        tr->size[tr->n++] = sz;
+    }
+    fclose(fp);
+    return 0;
+}
+
+static int size_class(int size) {
+    int c = 0;
+    while (size >>= 1) c++;
+    return c;
+}
+
+/* ---- Indexed min-heap over slots ---- */
+
+static bool heap_less(const ObjCache *c, int a, int b) {
+    if (c->prio[a] != c->prio[b]) return c->prio[a] < c->prio[b];
+    return c->last[a] < c->last[b];
+}
+
+static void heap_set(ObjCache *c, int i, int s) {
+    c->heap[i] = s;
+    c->pos[s] = i;
+}
+
+static void heap_up(ObjCache *c, int i) {
+    int s = c->heap[i];
+    while (i > 0 && heap_less(c, s, c->heap[(i - 1) / 2])) {
+        heap_set(c, i, c->heap[(i - 1) / 2]);
+        i = (i - 1) / 2;
+    }
+    heap_set(c, i, s);
+}
+
+static void heap_down(ObjCache *c, int i) {
+    int s = c->heap[i];
+    while (2 * i + 1 < c->count) {
+        int ch = 2 * i + 1;
+        if (ch + 1 < c->count && heap_less(c, c->heap[ch + 1], c->heap[ch])) ch++;
+        if (!heap_less(c, c->heap[ch], s)) break;
+        heap_set(c, i, c->heap[ch]);
+        i = ch;
+    }
+    heap_set(c, i, s);
+}
+
+/**
+ * heap_fix - Restores the heap after the priority of slot @s changed.
+ */
+static void heap_fix(ObjCache *c, int s) {
+    int i = c->pos[s];
+    heap_up(c, i);
+    heap_down(c, c->pos[s]);
+}
+
+/* ---- Size-class LRU lists ---- */
+
+static void list_unlink(ObjCache *c, int s) {
+    int cl = size_class(c->size[s]);
+    if (c->prev[s] != -1) c->next[c->prev[s]] = c->next[s]; else c->head[cl] = c->next[s];
+    if (c->next[s] != -1) c->prev[c->next[s]] = c->prev[s]; else c->tail[cl] = c->prev[s];
+}
+
+static void list_push(ObjCache *c, int s) {
+    int cl = size_class(c->size[s]);
+    c->prev[s] = -1;
+    c->next[s] = c->head[cl];
+    if (c->head[cl] != -1) c->prev[c->head[cl]] = s; else c->tail[cl] = s;
+    c->head[cl] = s;
+}
+
+static void cache_init(ObjCache *c, ObjPolicy policy, long long capacity) {
+    memset(c, 0, sizeof(*c));
+    c->policy = policy;
+    c->capacity = capacity;
+    for (int i = 0; i < SIZE_CLASSES; i++) c->head[i] = c->tail[i] = -1;
+    pagemap_init(&c->map, 1024);
+    pagemap_init(&c->hist, policy == OBJ_LRU2 ? 1024 : 1);
+}
+
+static void cache_free(ObjCache *c) {
+    free(c->key);
+    free(c->size);
+    free(c->freq);
+    free(c->last);
+    free(c->heap);
+    free(c->pos);
+    free(c->prev);
+    free(c->next);
+    free(c->free_slots);
+    free(c->prio);
+    pagemap_free(&c->map);
+    pagemap_free(&c->hist);
+}
+
+static int alloc_slot(ObjCache *c) {
+
+    if (c->nfree > 0) return c->free_slots[--c->nfree];
+
+    if (c->slots == c->cap) {
+        c->cap = c->cap ? c->cap * 2 : 256;
+        c->key  = (int*)realloc(c->key,  sizeof(int)*c->cap);
+        c->size = (int*)realloc(c->size, sizeof(int)*c->cap);
+        c->freq = (int*)realloc(c->freq, sizeof(int)*c->cap);
+        c->last = (int*)realloc(c->last, sizeof(int)*c->cap);
+        c->heap = (int*)realloc(c->heap, sizeof(int)*c->cap);
+        c->pos  = (int*)realloc(c->pos,  sizeof(int)*c->cap);
+        c->prev = (int*)realloc(c->prev, sizeof(int)*c->cap);
+        c->next = (int*)realloc(c->next, sizeof(int)*c->cap);
+        c->free_slots = (int*)realloc(c->free_slots, sizeof(int)*c->cap);
+        c->prio = (double*)realloc(c->prio, sizeof(double)*c->cap);
+    }
+    return c->slots++;
+}
+
+/**
+ * set_prio - Priority of slot @s after a reference at time @t.
+ * @prev_ref: Time of the reference before this one (-1 if none).
+ */
+static void set_prio(ObjCache *c, int s, int t, int prev_ref) {
+    switch (c->policy) {
+    case OBJ_LRU:  c->prio[s] = t; break;
+    case OBJ_LRU2: c->prio[s] = prev_ref; break;
+    case OBJ_GDSF: c->prio[s] = c->L + (double)c->freq[s] / c->size[s]; break;
+    default: break;
+    }
+}
+
+/**
+ * pick_victim - Slot to evict under the cache's policy.
+ */
+static int pick_victim(const ObjCache *c, int t) {
+
+    if (c->policy != OBJ_SIZE_LRU) return c->heap[0];
+
+    int victim = -1;
+    double best = -1;
+    for (int cl = 0; cl < SIZE_CLASSES; cl++) {
+        int s = c->tail[cl];
+        if (s == -1) continue;
+        double score = (double)c->size[s] * (t - c->last[s] + 1);
+        if (score > best) {
+            best = score;
+            victim = s;
+        }
+    }
+    return victim;
+}
+
+static void evict(ObjCache *c, int s) {
+
+    c->count--;
+    if (c->policy == OBJ_SIZE_LRU) list_unlink(c, s);
+    else {
+        // Fill the hole with the last heap entry
+        int i = c->pos[s];
+        int moved = c->heap[c->count];
+        if (i < c->count) {
+            heap_set(c, i, moved);
+            heap_fix(c, moved);
+        }
+    }
+    c->used -= c->size[s];
+    *pagemap_get(&c->map, c->key[s]) = -1;
+    c->free_slots[c->nfree++] = s;
+}
+
+/**
+ * simulate_objcache - Replays the object trace under one policy.
+ * Logic:
+ * - HIT: same object and size cached; refresh its position / priority.
+ *   A cached object whose size changed is dropped and handled as a miss.
+ * - MISS: evict until the object fits, then insert it.
+ */
+static void simulate_objcache(const ObjTrace *tr, ObjPolicy policy, ObjResult *res) {
+
+    ObjCache c;
+    cache_init(&c, policy, tr->capacity);
+    memset(res, 0, sizeof(*res));
+
+    for (int t = 0; t < tr->n; t++) {
+
+        int k = tr->key[t], sz = tr->size[t];
+        res->req_bytes += sz;
+
+        int prev_ref = -1;
+        if (policy == OBJ_LRU2) {
+            int *h = pagemap_put(&c.hist, k, -1);
+            prev_ref = *h;
+            *h = t;
+        }
+
+        int *sp = pagemap_put(&c.map, k, -1);
+        int s = *sp;
+        if (s >= 0 && c.size[s] != sz) {
+            evict(&c, s);
+            s = -1;
+        }
+
+        if (s >= 0) {
+            res->hits++;
+            res->hit_bytes += sz;
+            c.freq[s]++;
+            if (policy == OBJ_SIZE_LRU) list_unlink(&c, s);
+            c.last[s] = t;
+            if (policy == OBJ_SIZE_LRU) list_push(&c, s);
+            else {
+                set_prio(&c, s, t, prev_ref);
+                heap_fix(&c, s);
+            }
+            continue;
+        }
+
+        if (sz > c.capacity) {
+            res->bypassed++;
+            continue;
+        }
+        while (c.used + sz > c.capacity) {
+            int v = pick_victim(&c, t);
+            // GDSF ages by the priority of evicted objects only, not of replaced ones
+            if (policy == OBJ_GDSF) c.L = c.prio[v];
+            evict(&c, v);
+            res->evictions++;
+        }
+
+        s = alloc_slot(&c);
+        c.key[s] = k;
+        c.size[s] = sz;
+        c.freq[s] = 1;
+        c.last[s] = t;
+        c.used += sz;
+        *pagemap_get(&c.map, k) = s;
+        if (policy == OBJ_SIZE_LRU) {
+            list_push(&c, s);
+            c.count++;
+        } else {
+            set_prio(&c, s, t, prev_ref);
+            heap_set(&c, c.count++, s);
+            heap_up(&c, c.count - 1);
+        }
+    }
+    cache_free(&c);
+}
+
+int run_object_cache(const char *path) {
+
+    ObjTrace tr;
+    if (read_obj_trace(path, &tr) != 0) return -1;
+
+    PageMap seen;
+    pagemap_init(&seen, 1024);
+    long long unique = 0;
+    for (int t = 0; t < tr.n; t++) {
+        int *v = pagemap_put(&seen, tr.key[t], 0);
+        if (*v == 0) {
+            *v = 1;
+            unique++;
+        }
+    }
+    pagemap_free(&seen);
+
+    printf("Object Cache (capacity %lld bytes, %d requests, %lld objects):\n",
+           tr.capacity, tr.n, unique);
+    printf("%-13s %10s %9s %12s %10s %9s\n", "Policy", "Hits", "HitRate", "ByteHitRate",
+           "Evictions", "Bypassed");
+
+    for (int p = OBJ_LRU; p <= OBJ_SIZE_LRU; p++) {
+        ObjResult res;
+        simulate_objcache(&tr, (ObjPolicy)p, &res);
+        printf("%-13s %10lld %8.2f%% %11.2f%% %10lld %9lld\n", obj_policy_names[p], res.hits,
+               tr.n ? res.hits * 100.0 / tr.n : 0,
+               res.req_bytes ? res.hit_bytes * 100.0 / res.req_bytes : 0,
+               res.evictions, res.bypassed);
+    }
+    printf("\n");
+
+    free(tr.key);
+    free(tr.size);
+    return 0;
+}
@@ -1,24 +1,62 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <unistd.h>
 
-#define MAX_FRAMES 1000 
+#include "page_replacement_simulator.h"
 
+/**
+ * VarResult - Result of a variable-allocation policy (Working Set, PFF)
+ * - space_time: Sum of the resident set size over every reference (frame-refs).
+ */
 typedef struct {
-    int *refs;  // Array containing the actual Page Numbers
-    int n;      // Length of the reference sequence
-} RefSeq;
+    int faults;
+    int peak;               // Largest resident set observed
+    double avg_resident;    // Average resident set size
+    long long space_time;
+} VarResult;
+
+/**
+ * scan_ref - Reads one reference: a page number, optionally suffixed with
+ * 'w' (store) or 'r' (load), e.g. "7w".
+ * Returns 1 on success, otherwise the fscanf() result.
+ */
+int scan_ref(FILE *fp, int *page, bool *is_write) {
+
+    int ret = fscanf(fp, "%d", page);
+    if (ret != 1) return ret;
+
+    int c = fgetc(fp);
+    *is_write = (c == 'w' || c == 'W');
+    if (!*is_write && c != 'r' && c != 'R' && c != EOF) ungetc(c, fp);
+    return 1;
+}
 
 /**
  * read_input - Reads the page frame size and reference string from a file.
+ * Text inputs and binary traces (trace_format.c) are both accepted.
+ * Pages written as "7w" are stores; seq->write stays NULL if there are none.
  * @path: Path to the input file
  * @frames: Pointer to store the number of frames
  * @seq: Pointer to the RefSeq structure to store page references
  */
-static int read_input(const char *path, int *frames, RefSeq *seq) {
+int read_input(const char *path, int *frames, RefSeq *seq) {
 
     FILE *fp = fopen(path, "r");
+    if (fp == NULL) {
+        fprintf(stderr, "Can't open %s\n", path);
+        return -1;
+    }
+
+    // Binary traces are recognised by their magic number
+    if (trace_is_binary(fp)) {
+        fclose(fp);
+        return read_trace(path, frames, seq);
+    }
      
     // Read the number of page frames
     if (fscanf(fp, "%d", frames) != 1) {
@@ -37,16 +75,22 @@ static int read_input(const char *path, int *frames, RefSeq *seq) {
     // Allocate memory for the reference sequence (initial capacity: 128)
     int cap = 128;
     seq->refs = (int*)malloc(sizeof(int)*cap);
+    seq->write = NULL;
     seq->n = 0;
 
     // Read page numbers until the end of the file
     int x;
-    while (fscanf(fp, "%d", &x) == 1) {
+    bool w;
+    while (scan_ref(fp, &x, &w) == 1) {
         // Resize the array if the capacity is exceeded
         if (seq->n == cap) {
             cap *= 2;
             seq->refs = (int*)realloc(seq->refs, sizeof(int)*cap);
+            if (seq->write) seq->write = (unsigned char*)realloc(seq->write, cap);
         }
+        // Store flags are only kept once the first store shows up
+        if (w && seq->write == NULL) seq->write = (unsigned char*)calloc(cap, 1);
+        if (seq->write) seq->write[seq->n] = w;
         seq->refs[seq->n++] = x; // Store page number in the sequence
     }
 
@@ -54,19 +98,98 @@ static int read_input(const char *path, int *frames, RefSeq *seq) {
     return 0;
 }
 
+static unsigned pagemap_hash(int page, int cap) {
+    unsigned h = (unsigned)page * 2654435761u;
+    return (h ^ (h >> 15)) & (unsigned)(cap - 1);
+}
+
 /**
- * find_in_frames - Checks if a specific page exists in the current frames.
- * @frames: Current page frames array
- * @f: Total number of frames
- * @page: Target page number to search for
- * Returns the index if found, otherwise returns -1.
+ * pagemap_init - Allocates an empty map with room for at least @hint pages.
  */
-static int find_in_frames(const int *frames, int f, int page) {
+void pagemap_init(PageMap *m, int hint) {
+    m->cap = 16;
+    while (m->cap < hint * 2) m->cap *= 2;
+    m->keys = (int*)malloc(sizeof(int)*m->cap);
+    m->vals = (int*)malloc(sizeof(int)*m->cap);
+    for (int i = 0; i < m->cap; i++) m->keys[i] = -1;
+    m->used = 0;
+}
 
-    for (int i = 0; i < f; i++) 
-        if (frames[i] == page) return i; // Returns if the index containing the page is found
+void pagemap_free(PageMap *m) {
+    free(m->keys);
+    free(m->vals);
+}
+
+/**
+ * pagemap_get - Looks up a page.
+ * Returns a pointer to its value, or NULL if the page is not in the map.
+ */
+int *pagemap_get(const PageMap *m, int page) {
+    unsigned i = pagemap_hash(page, m->cap);
+    while (m->keys[i] != -1) {
+        if (m->keys[i] == page) return &m->vals[i];
+        i = (i + 1) & (unsigned)(m->cap - 1);
+    }
+    return NULL;
+}
 
-    return -1; 
+/**
+ * pagemap_put - Finds a page, inserting it with value @init if it is absent.
+ * The map doubles once it is half full, so the returned pointer is only
+ * valid until the next pagemap_put().
+ */
+int *pagemap_put(PageMap *m, int page, int init) {
+    if (m->used * 2 >= m->cap) {
+        PageMap big;
+        pagemap_init(&big, m->cap);
+        for (int i = 0; i < m->cap; i++)
+            if (m->keys[i] != -1) *pagemap_put(&big, m->keys[i], 0) = m->vals[i];
+        pagemap_free(m);
+        *m = big;
+    }
+    unsigned i = pagemap_hash(page, m->cap);
+    while (m->keys[i] != -1) {
+        if (m->keys[i] == page) return &m->vals[i];
+        i = (i + 1) & (unsigned)(m->cap - 1);
+    }
+    m->keys[i] = page;
+    m->vals[i] = init;
+    m->used++;
+    return &m->vals[i];
+}
+
+/**
+ * opt_sift_up, opt_sift_down - Max-heap of frame indexes ordered by next use
+ * Among frames whose page is never used again (same key) the lower frame
+ * index comes first, so the victim is the same one a scan of the frames finds.
+ */
+static bool opt_before(const int *key, int a, int b) {
+    return key[a] > key[b] || (key[a] == key[b] && a < b);
+}
+
+static void opt_sift_up(int *heap, int *pos, const int *key, int i) {
+    int f = heap[i];
+    while (i > 0 && opt_before(key, f, heap[(i - 1) / 2])) {
+        heap[i] = heap[(i - 1) / 2];
+        pos[heap[i]] = i;
+        i = (i - 1) / 2;
+    }
+    heap[i] = f;
+    pos[f] = i;
+}
+
+static void opt_sift_down(int *heap, int *pos, const int *key, int n, int i) {
+    int f = heap[i];
+    while (2 * i + 1 < n) {
+        int c = 2 * i + 1;
+        if (c + 1 < n && opt_before(key, heap[c + 1], heap[c])) c++;
+        if (!opt_before(key, heap[c], f)) break;
+        heap[i] = heap[c];
+        pos[heap[i]] = i;
+        i = c;
+    }
+    heap[i] = f;
+    pos[f] = i;
 }
 
 /**
@@ -76,61 +199,85 @@ static int find_in_frames(const int *frames, int f, int page) {
  * - MISS:
  * (1) If there is an empty frame, use it.
  * (2) Otherwise, replace the page that will not be used for the longest period in the future.
+ * - nextuse[k]: Position of the next reference to refs[k] (n if none), filled in
+ *   by one backward pass, so each frame's next use is known without scanning ahead.
+ * - The frames sit in a max-heap keyed by next use: the victim is the root, and
+ *   a hit only moves its frame up (its next use moves later). O(log F) per reference.
  */
-static int simulate_opt(int F, const RefSeq *seq) {
+static int simulate_opt(int F, const RefSeq *seq, SimStats *st) {
     
+    int n = seq->n;
     int *frames = (int*)malloc(sizeof(int)*F);
-    for (int i = 0; i < F; ++i) frames[i] = -1; // Initialize as empty (-1)
+    char *dirty = (char*)calloc(F, sizeof(char));
+    int *key  = (int*)malloc(sizeof(int)*F);    // Next use of the page in each frame
+    int *heap = (int*)malloc(sizeof(int)*F);
+    int *pos  = (int*)malloc(sizeof(int)*F);    // Heap position of each frame
+    int *nextuse = (int*)malloc(sizeof(int)*(n ? n : 1));
+
+    // Next occurrence of every reference (backward pass)
+    PageMap where;
+    pagemap_init(&where, F);
+    for (int k = n - 1; k >= 0; k--) {
+        int *nx = pagemap_put(&where, seq->refs[k], n);
+        nextuse[k] = *nx;
+        *nx = k;
+    }
+    pagemap_free(&where);
+    pagemap_init(&where, F);    // Now page -> frame (-1 once evicted)
 
     int faults = 0; // Page faluts
     int filled = 0; // Number of currently occupied frames
+    st->writebacks = 0;
 
-    for (int k = 0; k < seq->n; k++) {
+    for (int k = 0; k < n; k++) {
 
         int p = seq->refs[k]; // currently referring page
+        bool w = ref_is_write(seq, k);
 
-        int hit_idx = find_in_frames(frames, F, p);
-        if (hit_idx != -1) continue; // if hit, continue
+        int *fr = pagemap_put(&where, p, -1);
+        int hit_idx = *fr;
+        if (hit_idx != -1) { // if hit, continue
+            dirty[hit_idx] |= w;
+            key[hit_idx] = nextuse[k];
+            opt_sift_up(heap, pos, key, pos[hit_idx]);
+            continue;
+        }
 
         faults++; // MISS occured
+        record_fault(st, k);
 
         // 1) Fill empty frame if available
         if (filled < F) {                      
-            frames[filled++] = p;
+            dirty[filled] = w;
+            frames[filled] = p;
+            key[filled] = nextuse[k];
+            heap[filled] = filled;
+            *fr = filled;
+            opt_sift_up(heap, pos, key, filled++);
             continue;
         }
 
-        // 2) Select a victim for replacement
+        // 2) Select a victim for replacement: the root of the heap
         //   - Priority 1: A page that is never referenced again.
         //   - Priority 2: A page whose next reference is the furthest in the future.
-        int found = 0;
-	    int furthest = -1; 
-        for (int i = 0; i < F; i++) {
-            int next = -1;
-		
-            // Search for the next occurrence of frames[i]
-            for (int j = k+1; j < seq->n; j++) {
-                if (seq->refs[j] == frames[i]) {
-		       	    next = j; 
-			        break;
-                }
-            }
-            // Replace immediately if the page will never be used again
-            if (next == -1) {
-		        found = i;
-		        break;
-            }   
-            // Track the page with the furthest next reference
-            if (next > furthest) {
-                furthest = next; 
-                found = i; 
-            }
-        }
+        int found = heap[0];
 
+        if (dirty[found]) st->writebacks++; // Write back the dirty victim
+        *pagemap_get(&where, frames[found]) = -1;
+        *pagemap_get(&where, p) = found;
         frames[found] = p; // Perform replacement
+        dirty[found] = w;
+        key[found] = nextuse[k];
+        opt_sift_down(heap, pos, key, F, 0);
     }
 
+    pagemap_free(&where);
     free(frames);
+    free(dirty);
+    free(key);
+    free(heap);
+    free(pos);
+    free(nextuse);
     return faults;
 }
 
@@ -139,32 +286,52 @@ static int simulate_opt(int F, const RefSeq *seq) {
  * Logic:
  * - Replaces the oldest page in the frames.
  * - idx: Points to the frame that was loaded first (circular queue behavior).
+ * - where: Page -> frame index (-1 once evicted), so a hit costs one lookup.
  */
-static int simulate_fifo(int F, const RefSeq *seq) {
+static int simulate_fifo(int F, const RefSeq *seq, SimStats *st) {
 
     int *frames = (int*)malloc(sizeof(int)*F);
+    char *dirty = (char*)calloc(F, sizeof(char));
     for (int i = 0; i < F; i++) frames[i] = -1; // Initialize as empty (-1)
 
+    PageMap where;
+    pagemap_init(&where, F);
+
     int faults = 0; 
     int idx = 0; // Pointer to the next victim frame
     int  filled = 0; 
+    st->writebacks = 0;
 
     for (int t = 0; t < seq->n; t++) {
         int p = seq->refs[t];  
+        bool w = ref_is_write(seq, t);
 
-        if (find_in_frames(frames, F, p) != -1) continue; // HIT
+        int *hit_idx = pagemap_put(&where, p, -1);
+        if (*hit_idx != -1) { // HIT
+            dirty[*hit_idx] |= w;
+            continue;
+        }
         faults++; // MISS 
+        record_fault(st, t);
 
 	    // If the frame is still empty, fill it in.
         if (filled < F) {
+            *hit_idx = filled;
+            dirty[filled] = w;
             frames[filled++] = p;
         } else {
+            if (dirty[idx]) st->writebacks++; // Write back the dirty victim
+            *pagemap_get(&where, frames[idx]) = -1;
+            *hit_idx = idx;
             frames[idx] = p; // Replace the oldest frame when it is full
+            dirty[idx] = w;
             idx = (idx + 1) % F; 
         }
     }
 
     free(frames);
+    free(dirty);
+    pagemap_free(&where);
     return faults;
 }
 
@@ -172,56 +339,103 @@ static int simulate_fifo(int F, const RefSeq *seq) {
  * simulate_LRU - Least Recently Used (LRU) Page Replacement
  * Logic:
  * - frames[i]: Page number currently held in frame i.
- * - last[i]: Timestamp of the last usage of frame i.
- * - Victim selection: Replace the frame with the smallest last[i] value.
+ * - where: Page -> frame index (-1 once evicted).
+ * - prev/next: Doubly linked list over the frames in recency order, most
+ *   recent at head, so the LRU victim is always the tail.
  */
-static int simulate_lru(int F, const RefSeq *seq) {
+static int simulate_lru(int F, const RefSeq *seq, SimStats *st) {
 
     int *frames = (int*)malloc(sizeof(int)*F);
-    int *last   = (int*)malloc(sizeof(int)*F);
+    int *prev   = (int*)malloc(sizeof(int)*F);
+    int *next   = (int*)malloc(sizeof(int)*F);
+    char *dirty = (char*)calloc(F, sizeof(char));
 
-    // Initialize as empty (-1)
-    for (int i = 0; i < F; i++) {
-	    frames[i] = -1;
-	    last[i] = -1; 
-    }
+    PageMap where;
+    pagemap_init(&where, F);
 
     int faults = 0;
     int filled = 0;
+    int head = -1, tail = -1;
+    st->writebacks = 0;
 
     for (int t = 0; t < seq->n; t++) {
 
         int p = seq->refs[t]; 
-        int idx = find_in_frames(frames, F, p); 
+        bool w = ref_is_write(seq, t);
+        int *idx = pagemap_put(&where, p, -1);
+        int f = *idx;
 
-	    // HIT : Update last-used timestamp
-        if (idx != -1) {   
-            last[idx] = t;
-            continue;
-        }
-	    // MISS
-        faults++;
+	    // HIT : Unlink the frame, it moves to the head below
+        if (f != -1) {
+            dirty[f] |= w;
+            if (f == head) continue;
+            next[prev[f]] = next[f];
+            if (next[f] != -1) prev[next[f]] = prev[f]; else tail = prev[f];
+        } else {
+	        // MISS
+            faults++;
+            record_fault(st, t);
 
-	    // Fill empty frame
-        if (filled < F) {
-            frames[filled] = p;
-            last[filled] = t;
-	        filled++;    
-        }else {
-            // Find the LRU victim (oldest timestamp)
-            int victim = 0;
-            for (int i = 1; i < F; i++)
-                if (last[i] < last[victim]) victim = i; 
-            frames[victim] = p;
-            last[victim]   = t;
+	        // Fill empty frame, otherwise evict the LRU victim (the tail)
+            if (filled < F) {
+                f = filled++;
+            } else {
+                f = tail;
+                tail = prev[f];
+                if (tail != -1) next[tail] = -1; else head = -1;
+                if (dirty[f]) st->writebacks++; // Write back the dirty victim
+                *pagemap_get(&where, frames[f]) = -1;
+            }
+            frames[f] = p;
+            dirty[f]  = w;
+            *idx = f;
         }
+        prev[f] = -1;
+        next[f] = head;
+        if (head != -1) prev[head] = f; else tail = f;
+        head = f;
     }
 
     free(frames);
-    free(last);
+    free(prev);
+    free(next);
+    free(dirty);
+    pagemap_free(&where);
     return faults;
 }
 
+/**
+ * clock_advance - Moves the clock hand to the next frame whose reference bit is 0.
+ * Logic:
+ * - refb: Reference bits packed 64 frames per word.
+ * - In the word under the hand, the first clear bit at or after the hand is
+ *   found with ctz; every set bit passed on the way gets its second chance
+ *   (cleared) in a single mask operation.
+ * - A word with no clear bit is cleared as a whole and the hand jumps to the next word.
+ * Returns the victim frame.
+ */
+static int clock_advance(uint64_t *refb, int F, int hand) {
+
+    int nwords = (F + 63) / 64;
+    uint64_t tail_mask = (F % 64) ? (1ULL << (F % 64)) - 1 : ~0ULL; // Valid bits of the last word
+
+    while (1) {
+        int w = hand / 64;
+        uint64_t valid  = (w == nwords - 1) ? tail_mask : ~0ULL;
+        uint64_t window = valid & (~0ULL << (hand % 64)); // Frames from the hand to the end of the word
+        uint64_t clear  = ~refb[w] & window;
+
+        if (clear) {
+            int bit = __builtin_ctzll(clear);
+            refb[w] &= ~(window & ((1ULL << bit) - 1)); // Second chance for the frames passed
+            return w * 64 + bit;
+        }
+        refb[w] &= ~window;
+        hand = (w + 1) * 64;
+        if (hand >= F) hand = 0;
+    }
+}
+
 /**
  * simulate_clock - Clock (Second-Chance) Algorithm
  * Logic:
@@ -229,64 +443,340 @@ static int simulate_lru(int F, const RefSeq *seq) {
  * - hand: A pointer (clock hand) that traverses frames to find a victim.
  * - If hand finds refb == 1, it clears the bit (0) and moves to the next frame (second chance).
  * - If hand finds refb == 0, that frame is selected for replacement.
+ * - where: Page -> frame index, so hits are found in O(1) and the hand is the
+ *   only scan left (done a word at a time by clock_advance()).
  */
-static int simulate_clock(int F, const RefSeq *seq) {
+static int simulate_clock(int F, const RefSeq *seq, SimStats *st) {
 
     // Initialzie
     int *frames = (int*)malloc(sizeof(int)*F);
-    char *refb  = (char*)malloc(sizeof(char)*F);
-    for (int i = 0; i < F; i++) {
-	    frames[i] = -1; 
-	    refb[i] = 0; 
-    }
+    uint64_t *refb = (uint64_t*)calloc((F + 63) / 64, sizeof(uint64_t));
+    char *dirty = (char*)calloc(F, sizeof(char));
+    for (int i = 0; i < F; i++) frames[i] = -1;
+
+    PageMap where;
+    pagemap_init(&where, F);
 
     int faults = 0; 
     int hand = 0; // Clock hand index
     int filled = 0; 
+    st->writebacks = 0;
 
     for (int t = 0; t < seq->n; t++) {
 
         int p = seq->refs[t]; 
+        bool w = ref_is_write(seq, t);
 
 	    // Check for HIT
-        int idx = find_in_frames(frames, F, p); 
-        if (idx != -1) {
-	       	refb[idx] = 1;
+        int *idx = pagemap_put(&where, p, -1);
+        if (*idx != -1) {
+            refb[*idx / 64] |= 1ULL << (*idx % 64);
+            dirty[*idx] |= w;
 	       	continue;
        	} 
 
 	    // MISS
         faults++;
+        record_fault(st, t);
 
-        // 1) Fill empty frame if available
+        // 1) Fill empty frame if available, 2) otherwise Clock replacement
+        int victim;
         if (filled < F) {
-            frames[filled] = p;
-            refb[filled] = 1;
-	        filled++;
+            victim = filled++;
+        } else {
+            victim = clock_advance(refb, F, hand);
+            if (dirty[victim]) st->writebacks++; // Write back the dirty victim
+            *pagemap_get(&where, frames[victim]) = -1;
+            hand = (victim + 1) % F; // Advance hand
         }
-        // 2) Perform Clock replacement if frames are full
-        else {
-            while(1) {
-                // If reference bit is 0, replace the page
-                if (refb[hand] == 0) {
-                    frames[hand] = p;
-                    refb[hand] = 1; // New page gets its bit set to 1
-                    hand = (hand + 1) % F; // Advance hand
-                    break;
-                } else {
-                    // Give a second chance: clear bit and advance hand
-                    refb[hand] = 0;
-                    hand = (hand + 1) % F;
+        frames[victim] = p;
+        dirty[victim] = w;
+        refb[victim / 64] |= 1ULL << (victim % 64); // New page gets its bit set to 1
+        *idx = victim;
+    }
+
+    free(frames);
+    free(refb);
+    free(dirty);
+    pagemap_free(&where);
+    return faults;
+}
+
+/**
+ * simulate_gclock - Generalized Clock (GCLOCK) Algorithm
+ * Logic:
+ * - cnt[i]: Reference counter instead of a single bit. A hit adds 1 (up to
+ *   gclock_max), a new page starts at 1.
+ * - The hand decrements non-zero counters as it passes and replaces the
+ *   first frame whose counter is 0, so frequently used pages survive several sweeps.
+ * - When every counter is still non-zero after a full sweep, the smallest
+ *   counter is subtracted from all of them at once instead of sweeping again.
+ */
+static int gclock_max = 0;
+
+static int simulate_gclock(int F, const RefSeq *seq, SimStats *st) {
+
+    int *frames = (int*)malloc(sizeof(int)*F);
+    unsigned char *cnt = (unsigned char*)calloc(F, sizeof(unsigned char));
+    char *dirty = (char*)calloc(F, sizeof(char));
+    for (int i = 0; i < F; i++) frames[i] = -1;
+
+    PageMap where;
+    pagemap_init(&where, F);
+
+    int faults = 0;
+    int hand = 0;
+    int filled = 0;
+    st->writebacks = 0;
+
+    for (int t = 0; t < seq->n; t++) {
+
+        int p = seq->refs[t];
+        bool w = ref_is_write(seq, t);
+
+        // HIT
+        int *idx = pagemap_put(&where, p, -1);
+        if (*idx != -1) {
+            if (cnt[*idx] < gclock_max) cnt[*idx]++;
+            dirty[*idx] |= w;
+            continue;
+        }
+
+        // MISS
+        faults++;
+        record_fault(st, t);
+
+        int victim = -1;
+        if (filled < F) {
+            victim = filled++;
+        } else {
+            while (victim == -1) {
+                int min = 255;
+                for (int i = 0; i < F; i++, hand = (hand + 1) % F) {
+                    if (cnt[hand] == 0) {
+                        victim = hand;
+                        break;
+                    }
+                    if (--cnt[hand] < min) min = cnt[hand];
                 }
+                // Full sweep without a victim: age everyone by the smallest counter
+                if (victim == -1 && min > 0)
+                    for (int i = 0; i < F; i++) cnt[i] -= min;
             }
+            if (dirty[victim]) st->writebacks++;
+            *pagemap_get(&where, frames[victim]) = -1;
+            hand = (victim + 1) % F;
         }
+        frames[victim] = p;
+        dirty[victim] = w;
+        cnt[victim] = 1;
+        *idx = victim;
+    }
+
+    free(frames);
+    free(cnt);
+    free(dirty);
+    pagemap_free(&where);
+    return faults;
+}
+
+/**
+ * simulate_nru - Enhanced Second-Chance (NRU) Algorithm
+ * Logic:
+ * - Each frame belongs to a class (reference bit, dirty bit):
+ *   (0,0) < (0,1) < (1,0) < (1,1), the lowest class is replaced first.
+ * - Pass 1: the hand looks for a (0,0) frame without touching any bit.
+ * - Pass 2: the hand looks for a (0,1) frame, clearing reference bits as it goes.
+ * - If neither pass finds one, every reference bit is now 0, so repeating finds a victim.
+ * - Clean pages are preferred, so fewer evictions need a write-back.
+ */
+static int simulate_nru(int F, const RefSeq *seq, SimStats *st) {
+
+    int *frames = (int*)malloc(sizeof(int)*F);
+    char *refb  = (char*)calloc(F, sizeof(char));
+    char *dirty = (char*)calloc(F, sizeof(char));
+    for (int i = 0; i < F; i++) frames[i] = -1;
+
+    PageMap where;
+    pagemap_init(&where, F);
+
+    int faults = 0;
+    int hand = 0;
+    int filled = 0;
+    st->writebacks = 0;
+
+    for (int t = 0; t < seq->n; t++) {
+
+        int p = seq->refs[t];
+        bool w = ref_is_write(seq, t);
+
+        // HIT
+        int *idx = pagemap_put(&where, p, -1);
+        if (*idx != -1) {
+            refb[*idx] = 1;
+            dirty[*idx] |= w;
+            continue;
+        }
+
+        // MISS
+        faults++;
+        record_fault(st, t);
+
+        int victim = -1;
+        if (filled < F) {
+            victim = filled++;
+        } else {
+            while (victim == -1) {
+                // Pass 1: (0,0)
+                for (int i = 0; i < F && victim == -1; i++, hand = (hand + 1) % F)
+                    if (!refb[hand] && !dirty[hand]) victim = hand;
+                // Pass 2: (0,1), clearing reference bits
+                for (int i = 0; i < F && victim == -1; i++, hand = (hand + 1) % F) {
+                    if (!refb[hand]) victim = hand;
+                    else refb[hand] = 0;
+                }
+            }
+            if (dirty[victim]) st->writebacks++;
+            *pagemap_get(&where, frames[victim]) = -1;
+        }
+
+        frames[victim] = p;
+        refb[victim] = 1;
+        dirty[victim] = w;
+        *idx = victim;
     }
 
     free(frames);
     free(refb);
+    free(dirty);
+    pagemap_free(&where);
     return faults;
 }
 
+/**
+ * simulate_ws - Working Set (window tau) Variable-Allocation Policy
+ * Logic:
+ * - The resident set after time t is every page referenced in (t - tau, t].
+ * - last: Page -> time of its latest reference.
+ * - A page leaves the resident set when its latest reference slides out of the window,
+ *   so only the reference at t - tau needs to be checked on each step.
+ * - MISS: The referenced page is not in the previous window [t - tau, t - 1].
+ */
+static void simulate_ws(int tau, const RefSeq *seq, VarResult *res) {
+
+    PageMap last;
+    pagemap_init(&last, 1024);
+
+    int faults = 0;
+    int ws = 0;     // Current resident (working) set size
+    int peak = 0;
+    long long space_time = 0;
+
+    for (int t = 0; t < seq->n; t++) {
+
+        int p = seq->refs[t];
+        int *lt = pagemap_put(&last, p, -1);
+        bool hit = (*lt >= 0 && *lt >= t - tau); // Referenced in [t - tau, t - 1]
+
+        // Expire the reference that slides out of the window (unless it is re-referenced now)
+        if (t - tau >= 0 && seq->refs[t - tau] != p) {
+            if (*pagemap_get(&last, seq->refs[t - tau]) == t - tau) ws--;
+        }
+
+        // MISS
+        if (!hit) {
+            faults++;
+            ws++;
+        }
+        *lt = t;
+
+        if (ws > peak) peak = ws;
+        space_time += ws;
+    }
+
+    res->faults = faults;
+    res->peak = peak;
+    res->space_time = space_time;
+    res->avg_resident = seq->n ? (double)space_time / seq->n : 0;
+    pagemap_free(&last);
+}
+
+/**
+ * simulate_pff - Page-Fault-Frequency Variable-Allocation Policy
+ * Logic:
+ * - HIT: Set the use bit of the page.
+ * - MISS: Compare the time since the previous fault with the threshold T.
+ * (1) Faults are frequent (interval <= T): grow, the new page is simply added.
+ * (2) Faults are rare (interval > T): shrink, every page not used since the
+ *     previous fault is released and the remaining use bits are cleared.
+ * - slot: Page -> index in resident[] (or -1 once released).
+ */
+static void simulate_pff(int T, const RefSeq *seq, VarResult *res) {
+
+    PageMap slot;
+    pagemap_init(&slot, 1024);
+
+    int cap = 128;
+    int *resident = (int*)malloc(sizeof(int)*cap);
+    char *used    = (char*)malloc(sizeof(char)*cap);
+    int n_res = 0;
+
+    int faults = 0;
+    int last_fault = -1;
+    int peak = 0;
+    long long space_time = 0;
+
+    for (int t = 0; t < seq->n; t++) {
+
+        int p = seq->refs[t];
+        int *s = pagemap_put(&slot, p, -1);
+
+        // HIT
+        if (*s >= 0) {
+            used[*s] = 1;
+        } else {
+            // MISS
+            faults++;
+
+            if (last_fault >= 0 && t - last_fault > T) {
+                // Shrink: release pages that were not used since the last fault
+                for (int i = 0; i < n_res; ) {
+                    if (used[i]) {
+                        used[i++] = 0;
+                        continue;
+                    }
+                    *pagemap_get(&slot, resident[i]) = -1;
+                    resident[i] = resident[--n_res];
+                    used[i] = used[n_res];
+                    if (i < n_res) *pagemap_get(&slot, resident[i]) = i;
+                }
+            }
+
+            // Grow the resident array if needed
+            if (n_res == cap) {
+                cap *= 2;
+                resident = (int*)realloc(resident, sizeof(int)*cap);
+                used = (char*)realloc(used, sizeof(char)*cap);
+            }
+            resident[n_res] = p;
+            used[n_res] = 1;
+            *s = n_res++;
+            last_fault = t;
+        }
+
+        if (n_res > peak) peak = n_res;
+        space_time += n_res;
+    }
+
+    res->faults = faults;
+    res->peak = peak;
+    res->space_time = space_time;
+    res->avg_resident = seq->n ? (double)space_time / seq->n : 0;
+    free(resident);
+    free(used);
+    pagemap_free(&slot);
+}
+
 /**
  * print_result - Calculates and displays the simulation results.
  */
@@ -303,9 +793,301 @@ static void print_result(const char *title, int faults, int total_refs) {
     printf("Page Fault Rate: %.2f%%\n\n", rate); 
 }
 
+/**
+ * print_writeback_result - Displays the results of a run over a trace with stores.
+ * @wb_cost: Cost of one write-back relative to one page fault
+ */
+static void print_writeback_result(const char *title, int faults, int writebacks,
+                                   int total_refs, double wb_cost) {
+
+    double rate = 0;
+
+    if (total_refs != 0) {
+        rate = (faults * 100.0) / (double)total_refs;
+    }
+    printf("%s\n", title);
+    printf("Number of Page Faults: %d\n", faults);
+    printf("Page Fault Rate: %.2f%%\n", rate);
+    printf("Number of Write-backs: %d\n", writebacks);
+    printf("I/O Cost: %.2f (fault = 1, write-back = %.2f)\n\n", faults + writebacks * wb_cost, wb_cost);
+}
+
+/**
+ * print_var_result - Displays the result of a variable-allocation policy.
+ */
+static void print_var_result(const char *title, const VarResult *res, int total_refs) {
+
+    double rate = 0;
+
+    if (total_refs != 0) {
+        rate = (res->faults * 100.0) / (double)total_refs;
+    }
+    printf("%s\n", title);
+    printf("Number of Page Faults: %d\n", res->faults);
+    printf("Page Fault Rate: %.2f%%\n", rate);
+    printf("Average Resident Set: %.2f frames\n", res->avg_resident);
+    printf("Peak Resident Set: %d frames\n", res->peak);
+    printf("Space-Time Product: %lld frame-refs\n\n", res->space_time);
+}
+
+/*
+ * Fixed-allocation policies, in output order
+ * (NRU only runs when the trace carries stores, GCLOCK only with -G)
+ */
+static const struct {
+    const char *title;
+    const char *name;
+    SimFn fn;
+} policies[] = {
+    { "Optimal Algorithm:", "Optimal", simulate_opt },
+    { "FIFO Algorithm:",    "FIFO",    simulate_fifo },
+    { "LRU Algorithm:",     "LRU",     simulate_lru },
+    { "Clock Algorithm:",   "Clock",   simulate_clock },
+    { "Enhanced Second-Chance (NRU) Algorithm:", "NRU", simulate_nru },
+    { "GCLOCK Algorithm:",  "GCLOCK",  simulate_gclock },
+};
+#define NUM_POLICIES ((int)(sizeof(policies) / sizeof(policies[0])))
+
+/**
+ * print_sweep - Displays the faults of every policy for each swept frame count.
+ */
+static void print_sweep(const SimTask *tasks, int count, const int *active, int npol) {
+
+    printf("Frame Sweep:\n");
+    printf("%8s", "Frames");
+    for (int j = 0; j < npol; j++) printf("%10s", policies[active[j]].name);
+    printf("\n");
+
+    for (int i = 0; i < count; i++) {
+        printf("%8d", tasks[i * npol].frames);
+        for (int j = 0; j < npol; j++) printf("%10d", tasks[i * npol + j].faults);
+        printf("\n");
+    }
+    printf("\n");
+}
+
+/*
+ * Usage: page_replacement_simulator [-j threads] [-S from:to[:step]] [-W tau] [-P threshold] <input>
+ *        page_replacement_simulator -M [-t window] [-N numa] <timed trace>
+ *        page_replacement_simulator -R quantum [-t window] [-N numa] <input> <input>...
+ *        page_replacement_simulator -C <output trace> <input>
+ *        page_replacement_simulator -V <object trace>
+ *        page_replacement_simulator -K percent [-k from:to[:step]] <binary trace>
+ *        page_replacement_simulator -b max refs[:pages[:seed]] [-S from:to[:step]] [-G max count]
+ *        page_replacement_simulator -I format -F frames [-g page size] [-d] [-C <output trace>] <raw trace>
+ * -V                : Object cache mode, input is the capacity in bytes followed by
+ *                     "<object> <size>" records (byte-budget, size-aware policies)
+ * -b refs           : Benchmark every policy on synthetic uniform, Zipf, loop and phased
+ *                     reference strings of 10^3 up to the given references
+ *                     (default 65536 pages, seed 1; frame counts from -S)
+ * -C output         : Convert a text input to the binary trace format and exit
+ * -I format         : Input is a raw memory-access trace: lackey, perf or pin
+ * -F frames         : Page frame count for an imported trace
+ * -g page size      : Page size in bytes for an imported trace (default 4096)
+ * -d                : Collapse consecutive references to the same page when importing
+ * -T tlb            : Also run the TLB model, "default" or "l1:ways:stlb:ways" entries
+ * -H                : Map the TLB model with 2 MB huge pages
+ * -B cost           : Cost of a dirty-page write-back relative to a fault (default 1)
+ * -A window         : Also run the prefetch study, read-ahead window up to the given pages
+ * -G max count      : Also run GCLOCK with reference counters capped at the given value
+ * -Z ratio          : Also run the compressed-tier study, "[~]ratio[:major us:minor us]"
+ *                     ("~": compressed size sampled per page around the ratio)
+ * -L window         : Also report the fault rate of every policy per window of references,
+ *                     with phase-change and fault-burst detection
+ * -E file           : Write that timeline to a CSV file (JSON if the name ends in .json)
+ * -K percent        : Miss-ratio curve mode: LRU curve of a binary trace with SHARDS sampling
+ *                     at this rate, streamed from the trace without running any policy
+ * -k from:to[:step] : Cache sizes of that curve (default: powers of two)
+ * -j threads        : Worker threads for the simulations (default: online CPUs)
+ * -S from:to[:step] : Also sweep every policy across the given frame counts
+ * -W tau            : Also run the Working Set policy with window tau
+ * -P threshold      : Also run the PFF policy with the given inter-fault threshold
+ * -M                : Multi-process mode, one trace of "<time> <pid> <page>" records
+ * -R quantum        : Multi-process mode, one input file per process, round-robin scheduled
+ * -t window         : Thrashing detection window in references (default 1000)
+ * -N numa           : Multi-process modes: also run the NUMA model,
+ *                     "nodes[:local ns:remote ns[:migrate after]]" (default 80:140:8)
+ */
 int main(int argc, char **argv) {
 
-    if (argc != 2) {
+    int ws_tau = 0;
+    int pff_thr = 0;
+    bool mp_trace = false;
+    int rr_quantum = 0;
+    int window = 1000;
+    int nthreads = default_threads();
+    int sw_from = 0, sw_to = 0, sw_step = 1;
+    const char *convert_out = NULL;
+    int import_fmt = -1;
+    int import_frames = 0;
+    long page_size = 4096;
+    bool collapse = false;
+    const char *tlb_spec = NULL;
+    bool huge = false;
+    double wb_cost = 1.0;
+    int ra_max = 0;
+    double shards_pct = 0;
+    int mrc_from = 0, mrc_to = 0, mrc_step = 1;
+    int tl_window = 0;
+    const char *numa_spec = NULL;
+    const char *zswap_spec = NULL;
+    const char *bench_spec = NULL;
+    bool objcache = false;
+    const char *tl_export = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "W:P:MR:t:j:S:C:I:F:g:dT:HB:A:K:k:G:L:E:N:Z:b:V")) != -1) {
+        switch (opt) {
+        case 'W': ws_tau  = atoi(optarg); break;
+        case 'P': pff_thr = atoi(optarg); break;
+        case 'M': mp_trace = true; break;
+        case 'R': rr_quantum = atoi(optarg); break;
+        case 't': window = atoi(optarg); break;
+        case 'j': nthreads = atoi(optarg); break;
+        case 'C': convert_out = optarg; break;
+        case 'I':
+            import_fmt = import_parse_format(optarg);
+            if (import_fmt < 0) {
+                fprintf(stderr, "Unknown trace format %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'F': import_frames = atoi(optarg); break;
+        case 'g': page_size = atol(optarg); break;
+        case 'd': collapse = true; break;
+        case 'T': tlb_spec = optarg; break;
+        case 'H': huge = true; break;
+        case 'B': wb_cost = atof(optarg); break;
+        case 'A': ra_max = atoi(optarg); break;
+        case 'K': shards_pct = atof(optarg); break;
+        case 'G': gclock_max = atoi(optarg); break;
+        case 'L': tl_window = atoi(optarg); break;
+        case 'E': tl_export = optarg; break;
+        case 'N': numa_spec = optarg; break;
+        case 'Z': zswap_spec = optarg; break;
+        case 'b': bench_spec = optarg; break;
+        case 'V': objcache = true; break;
+        case 'S':
+            if (sscanf(optarg, "%d:%d:%d", &sw_from, &sw_to, &sw_step) < 2) sw_from = -1;
+            break;
+        case 'k':
+            if (sscanf(optarg, "%d:%d:%d", &mrc_from, &mrc_to, &mrc_step) < 2) mrc_from = -1;
+            break;
+        default:
+            fprintf(stderr, "Wrong input\n");
+            return 1;
+        }
+    }
+
+    if (ws_tau < 0 || pff_thr < 0 || rr_quantum < 0 || window <= 0 || nthreads <= 0 ||
+        sw_from < 0 || sw_to < sw_from || sw_step <= 0 || (sw_from == 0 && sw_to > 0) ||
+        page_size <= 0 || (page_size & (page_size - 1)) != 0 || wb_cost < 0 || ra_max < 0 ||
+        shards_pct < 0 || shards_pct > 100 || mrc_from < 0 || mrc_to < mrc_from || mrc_step <= 0 ||
+        (mrc_from == 0 && mrc_to > 0) || (mrc_from > 0 && shards_pct == 0) || gclock_max < 0 || gclock_max > 255 ||
+        tl_window < 0 || (tl_export && tl_window == 0)) {
+        fprintf(stderr, "Wrong input\n");
+        return 1;
+    }
+
+    TlbConfig tlb;
+    if (tlb_spec && tlb_parse_config(tlb_spec, &tlb) != 0) {
+        fprintf(stderr, "Wrong TLB geometry %s\n", tlb_spec);
+        return 1;
+    }
+    tlb.huge = huge;
+
+    NumaConfig numa;
+    if (numa_spec && (numa_parse_config(numa_spec, &numa) != 0 || !(mp_trace || rr_quantum > 0))) {
+        fprintf(stderr, "Wrong NUMA configuration %s\n", numa_spec);
+        return 1;
+    }
+
+    ZswapConfig zswap;
+    if (zswap_spec && zswap_parse_config(zswap_spec, &zswap) != 0) {
+        fprintf(stderr, "Wrong compressed tier configuration %s\n", zswap_spec);
+        return 1;
+    }
+
+    ImportOptions import = { IMPORT_LACKEY, 0, collapse };
+    if (import_fmt >= 0) {
+        if (import_frames <= 0 || import_frames > MAX_FRAMES || optind != argc - 1) {
+            fprintf(stderr, "Wrong input\n");
+            return 1;
+        }
+        import.format = (ImportFormat)import_fmt;
+        while ((1L << import.page_shift) < page_size) import.page_shift++;
+    }
+
+    // Synthetic throughput benchmark (no input file)
+    if (bench_spec) {
+        BenchOptions bo = { 0, 65536, 1, sw_from, sw_to, sw_step };
+        unsigned long long seed = 1;
+        if (sscanf(bench_spec, "%d:%d:%llu", &bo.max_refs, &bo.pages, &seed) < 1 ||
+            bo.max_refs <= 0 || bo.pages <= 0 || optind != argc) {
+            fprintf(stderr, "Wrong input\n");
+            return 1;
+        }
+        bo.seed = seed;
+
+        const char *names[NUM_POLICIES];
+        SimFn fns[NUM_POLICIES];
+        int npol = 0;
+        for (int j = 0; j < NUM_POLICIES; j++) {
+            // Synthetic strings have no stores, so NRU is left out as for such traces
+            if (policies[j].fn == simulate_nru) continue;
+            if (policies[j].fn == simulate_gclock && gclock_max == 0) continue;
+            names[npol] = policies[j].name;
+            fns[npol++] = policies[j].fn;
+        }
+        return run_benchmark(names, fns, npol, &bo) == 0 ? 0 : 1;
+    }
+
+    // Variable-size object cache
+    if (objcache) {
+        if (optind != argc - 1) {
+            fprintf(stderr, "Wrong input\n");
+            return 1;
+        }
+        return run_object_cache(argv[optind]) == 0 ? 0 : 1;
+    }
+
+    // Sampled miss-ratio curve, streamed from a binary trace
+    if (shards_pct > 0) {
+        if (optind != argc - 1) {
+            fprintf(stderr, "Wrong input\n");
+            return 1;
+        }
+        return run_mrc_study(argv[optind], shards_pct / 100, mrc_from, mrc_to, mrc_step) == 0 ? 0 : 1;
+    }
+
+    // Text (or raw trace) -> binary trace conversion
+    if (convert_out) {
+        if (optind != argc - 1) {
+            fprintf(stderr, "Wrong input\n");
+            return 1;
+        }
+        int ret = (import_fmt >= 0)
+            ? import_to_trace(argv[optind], &import, import_frames, convert_out)
+            : convert_text_trace(argv[optind], convert_out);
+        return ret == 0 ? 0 : 1;
+    }
+
+    // Multi-process modes (shared frame pool, global vs local replacement)
+    if (mp_trace || rr_quantum > 0) {
+        int ret;
+        if (mp_trace && optind == argc - 1)
+            ret = run_multiprocess_trace(argv[optind], window, numa_spec ? &numa : NULL);
+        else if (!mp_trace && optind < argc)
+            ret = run_multiprocess_rr(&argv[optind], argc - optind, rr_quantum, window,
+                                      numa_spec ? &numa : NULL);
+        else {
+            fprintf(stderr, "Wrong input\n");
+            return 1;
+        }
+        return ret == 0 ? 0 : 1;
+    }
+
+    if (optind != argc - 1) {
         fprintf(stderr, "Wrong input\n");
         return 1;
     }
@@ -313,22 +1095,92 @@ int main(int argc, char **argv) {
     int frames; 
     RefSeq sequence = {0}; 
 	
-    read_input(argv[1],&frames,&sequence);
+    if (import_fmt >= 0) {
+        frames = import_frames;
+        if (import_to_seq(argv[optind], &import, &sequence) != 0) return 1;
+    }
+    else if (read_input(argv[optind],&frames,&sequence) != 0) return 1;
 
-    // Run simulations for each of the four algorithms
-    int opt_faults   = simulate_opt(frames, &sequence);
-    int fifo_faults  = simulate_fifo(frames, &sequence);
-    int lru_faults   = simulate_lru(frames, &sequence);
-    int clock_faults = simulate_clock(frames, &sequence);
+    // Dirty-page accounting (write-backs, NRU) only applies to traces with stores
+    bool dirty = (sequence.write != NULL);
+
+    int active[NUM_POLICIES];
+    int npol = 0;
+    for (int j = 0; j < NUM_POLICIES; j++) {
+        if (policies[j].fn == simulate_nru && !dirty) continue;
+        if (policies[j].fn == simulate_gclock && gclock_max == 0) continue;
+        active[npol++] = j;
+    }
+
+    // One task per policy for the input frame count, then per policy per swept frame count
+    int sweep = sw_from > 0 ? (sw_to - sw_from) / sw_step + 1 : 0;
+    int ntask = npol * (1 + sweep);
+    SimTask *tasks = (SimTask*)malloc(sizeof(SimTask)*ntask);
+    for (int i = 0; i <= sweep; i++) {
+        for (int j = 0; j < npol; j++) {
+            SimTask *t = &tasks[i * npol + j];
+            t->fn = policies[active[j]].fn;
+            t->frames = (i == 0) ? frames : sw_from + (i - 1) * sw_step;
+            t->faults = 0;
+            t->stats.writebacks = 0;
+            t->stats.window = tl_window;
+            t->stats.timeline = NULL;
+            // Timelines only for the input frame count
+            if (i == 0 && tl_window > 0)
+                t->stats.timeline = (int*)calloc(sequence.n / tl_window + 1, sizeof(int));
+        }
+    }
+
+    // Run simulations for each of the algorithms (and the sweep) on the worker pool
+    run_tasks(tasks, ntask, &sequence, nthreads);
 
     // Output results
-    print_result("Optimal Algorithm:", opt_faults, sequence.n);
-    print_result("FIFO Algorithm:",    fifo_faults, sequence.n);
-    print_result("LRU Algorithm:",     lru_faults, sequence.n);
-    print_result("Clock Algorithm:",   clock_faults, sequence.n);
+    for (int j = 0; j < npol; j++) {
+        if (dirty)
+            print_writeback_result(policies[active[j]].title, tasks[j].faults, tasks[j].stats.writebacks,
+                                   sequence.n, wb_cost);
+        else
+            print_result(policies[active[j]].title, tasks[j].faults, sequence.n);
+    }
+    if (sweep > 0)
+        print_sweep(&tasks[npol], sweep, active, npol);
+
+    // Fault rate over time, phase changes and fault bursts
+    int ret = 0;
+    if (tl_window > 0) {
+        const char *names[NUM_POLICIES];
+        for (int j = 0; j < npol; j++) names[j] = policies[active[j]].name;
+        if (run_timeline_report(&sequence, tl_window, tasks, names, npol, tl_export) != 0) ret = 1;
+        for (int j = 0; j < npol; j++) free(tasks[j].stats.timeline);
+    }
+    free(tasks);
+
+    // Variable-allocation policies (resident set grows and shrinks over time)
+    char title[64];
+    VarResult var;
+    if (ws_tau > 0) {
+        simulate_ws(ws_tau, &sequence, &var);
+        snprintf(title, sizeof(title), "Working Set Algorithm (tau=%d):", ws_tau);
+        print_var_result(title, &var, sequence.n);
+    }
+    if (pff_thr > 0) {
+        simulate_pff(pff_thr, &sequence, &var);
+        snprintf(title, sizeof(title), "PFF Algorithm (T=%d):", pff_thr);
+        print_var_result(title, &var, sequence.n);
+    }
+
+    // Address translation cost on top of the frame pool
+    if (tlb_spec) run_tlb_model(frames, &sequence, &tlb);
+
+    // Read-ahead / stride prefetching
+    if (ra_max > 0) run_prefetch_study(frames, &sequence, ra_max);
+
+    // Compressed second tier
+    if (zswap_spec) run_zswap_study(frames, &sequence, &zswap);
 
     // Cleanup resources
     free(sequence.refs);
-    return 0;
+    free(sequence.write);
+    return ret;
 }
 
@@ -0,0 +1,420 @@
+#ifndef PAGE_REPLACEMENT_SIMULATOR_H
+#define PAGE_REPLACEMENT_SIMULATOR_H
+/*
+ * page_replacement_simulator.h
+ *
+ * Shared declarations for the page replacement simulator
+ *
+ * This file declares:
+ *  - the reference sequence and page map data structures
+ *  - cross-module function prototypes
+ *
+ * Source files using this header:
+ *  - page_replacement_simulator.c
+ *  - multiprocess.c
+ *  - numa.c
+ *  - parallel.c
+ *  - trace_format.c
+ *  - trace_import.c
+ *  - tlb.c
+ *  - prefetch.c
+ *  - mrc.c
+ *  - zswap.c
+ *  - timeline.c
+ *  - refgen.c
+ *  - bench.c
+ *  - objcache.c
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define MAX_FRAMES 1000 
+
+typedef struct {
+    int *refs;  // Array containing the actual Page Numbers
+    unsigned char *write;   // write[k] = 1 if reference k is a store (NULL: all reads)
+    int n;      // Length of the reference sequence
+} RefSeq;
+
+static inline bool ref_is_write(const RefSeq *seq, int k) {
+    return seq->write != NULL && seq->write[k];
+}
+
+/**
+ * PageMap - Open-addressing hash table from page number to an int value
+ * - keys[i]: Page number stored in slot i, or -1 if the slot is unused.
+ * - vals[i]: Value attached to that page (meaning depends on the caller).
+ * - cap: Number of slots, always a power of two (linear probing).
+ */
+typedef struct {
+    int *keys;
+    int *vals;
+    int cap;
+    int used;
+} PageMap;
+
+/**
+ * SimStats - Side results of one simulation run besides the fault count
+ * - writebacks: Dirty pages written back on eviction.
+ * - timeline: If not NULL, timeline[t / window] counts the faults of each
+ *   window of references (caller-allocated).
+ */
+typedef struct {
+    int writebacks;
+    int window;
+    int *timeline;
+} SimStats;
+
+static inline void record_fault(SimStats *st, int t) {
+    if (st->timeline) st->timeline[t / st->window]++;
+}
+
+/**
+ * SimTask - One independent simulation run (policy x frame count)
+ * - fn: Simulation function (simulate_opt, simulate_fifo, ...), returns the
+ *   fault count and fills in the side results.
+ * - faults, stats: Result slot, filled in by whichever worker runs the task.
+ */
+typedef int (*SimFn)(int F, const RefSeq *seq, SimStats *st);
+
+typedef struct {
+    SimFn fn;
+    int frames;
+    int faults;
+    SimStats stats;
+} SimTask;
+
+/* ============================================================
+ *  page_replacement_simulator.c
+ * ============================================================ */
+int read_input(const char *path, int *frames, RefSeq *seq);
+int scan_ref(FILE *fp, int *page, bool *is_write);
+
+void pagemap_init(PageMap *m, int hint);
+void pagemap_free(PageMap *m);
+int *pagemap_get(const PageMap *m, int page);
+int *pagemap_put(PageMap *m, int page, int init);
+
+/* ============================================================
+ *  multiprocess.c
+ * ============================================================ */
+
+/**
+ * MultiTrace - Interleaved reference stream of several processes
+ * - pid[k], page[k]: Process (dense index) and page of the k-th reference.
+ * - ids[p]: Process id printed for dense index p.
+ * - quota[p]: Frames process p may hold under local replacement.
+ */
+typedef struct {
+    int nproc;
+    int n;
+    int *pid;
+    int *page;
+    int *ids;
+    int *quota;
+    int pool;       // Total frames in the shared pool
+} MultiTrace;
+
+typedef struct NumaConfig NumaConfig;
+
+/*
+ * run_multiprocess_trace - Multi-process simulation from one timestamped trace
+ * @path   : File with the pool size followed by "<time> <pid> <page>" records
+ * @window : Window length (references) used for thrashing detection
+ * @numa   : Also run the NUMA model with this configuration (NULL: off)
+ */
+int run_multiprocess_trace(const char *path, int window, const NumaConfig *numa);
+
+/*
+ * run_multiprocess_rr - Multi-process simulation from per-process input files
+ * @paths   : Standard input files, one per process (their frame count is the local quota)
+ * @nproc   : Number of processes
+ * @quantum : References a process issues before the scheduler switches to the next one
+ * @window  : Window length (references) used for thrashing detection
+ * @numa    : Also run the NUMA model with this configuration (NULL: off)
+ */
+int run_multiprocess_rr(char **paths, int nproc, int quantum, int window, const NumaConfig *numa);
+
+/* ============================================================
+ *  numa.c
+ * ============================================================ */
+
+/**
+ * NumaConfig - Node count and costs of the NUMA model
+ * - local_ns, remote_ns: Latency of a reference served by the home node / another node.
+ * - migrate_after: Remote accesses after which a page moves home (0: never).
+ */
+struct NumaConfig {
+    int nodes;
+    int local_ns;
+    int remote_ns;
+    int migrate_after;
+};
+
+/*
+ * numa_parse_config - "nodes[:local_ns:remote_ns[:migrate_after]]"
+ * Returns -1 if the configuration is invalid.
+ */
+int numa_parse_config(const char *spec, NumaConfig *cfg);
+
+/*
+ * run_numa_model - Replays a multi-process trace over per-node frame pools
+ * under each placement policy, with and without page migration
+ */
+int run_numa_model(const MultiTrace *mt, const NumaConfig *cfg);
+
+/* ============================================================
+ *  parallel.c
+ * ============================================================ */
+
+/*
+ * run_tasks - Runs every task on a pool of worker threads
+ * @tasks    : Tasks to run, each one's faults slot receives its result
+ * @ntask    : Number of tasks
+ * @seq      : Read-only reference sequence shared by all tasks
+ * @nthreads : Number of workers (1 runs everything in the calling thread)
+ */
+int run_tasks(SimTask *tasks, int ntask, const RefSeq *seq, int nthreads);
+
+/*
+ * default_threads - Number of online CPUs (at least 1)
+ */
+int default_threads(void);
+
+/* ============================================================
+ *  trace_format.c
+ * ============================================================ */
+
+/**
+ * TraceWriter - Streaming encoder for the binary trace format
+ * - buf: References of the block being filled (flushed when full).
+ */
+typedef struct {
+    FILE *fp;
+    int frames;
+    uint64_t nrefs;         // References written so far
+    bool has_writes;        // At least one store was written
+    int64_t *buf;           // page << 1 | is_write
+    int nbuf;
+    unsigned char *payload; // Encoding scratch space for one block
+} TraceWriter;
+
+/**
+ * TraceReader - Streaming decoder over a memory-mapped binary trace
+ */
+typedef struct {
+    const unsigned char *base;  // Start of the mapping
+    size_t size;
+    size_t off;                 // Offset of the next block
+    int frames;
+    int version;
+    int block_refs;             // Most references in one block (buffer size for trace_reader_next)
+    bool has_writes;            // The trace carries at least one store
+    uint64_t nrefs;             // Total references announced by the header
+} TraceReader;
+
+int trace_writer_open(TraceWriter *w, const char *path, int frames);
+int trace_writer_put(TraceWriter *w, int page, bool is_write);
+int trace_writer_close(TraceWriter *w);
+
+int trace_is_binary(FILE *fp);
+int trace_reader_open(TraceReader *r, const char *path);
+int trace_reader_next(TraceReader *r, int *out, unsigned char *wout, int max);
+void trace_reader_close(TraceReader *r);
+
+/*
+ * read_trace - Loads a binary trace (read_input() dispatches here on the magic)
+ */
+int read_trace(const char *path, int *frames, RefSeq *seq);
+
+/*
+ * convert_text_trace - Converts a text input file to the binary trace format
+ */
+int convert_text_trace(const char *in, const char *out);
+
+/* ============================================================
+ *  trace_import.c
+ * ============================================================ */
+
+typedef enum {
+    IMPORT_LACKEY,  // valgrind --tool=lackey --trace-mem=yes
+    IMPORT_PERF,    // perf script -F ...,addr
+    IMPORT_PIN,     // pinatrace "ip: R|W addr"
+} ImportFormat;
+
+/**
+ * ImportOptions - How raw addresses become page references
+ * - page_shift: log2 of the page size.
+ * - collapse: Drop a reference to the same page as the previous one.
+ */
+typedef struct {
+    ImportFormat format;
+    int page_shift;
+    bool collapse;
+} ImportOptions;
+
+/*
+ * import_parse_format - "lackey", "perf" or "pin" -> ImportFormat (-1 if unknown)
+ */
+int import_parse_format(const char *name);
+
+/*
+ * import_to_seq - Imports a raw trace into a RefSeq
+ */
+int import_to_seq(const char *path, const ImportOptions *o, RefSeq *seq);
+
+/*
+ * import_to_trace - Streams a raw trace into a binary trace file
+ */
+int import_to_trace(const char *path, const ImportOptions *o, int frames, const char *out);
+
+/* ============================================================
+ *  tlb.c
+ * ============================================================ */
+
+/**
+ * TlbConfig - Geometry of the two TLB levels
+ * - huge: Map 2 MB regions instead of 4 KB pages (3-level walk).
+ */
+typedef struct {
+    int l1_entries;
+    int l1_ways;
+    int stlb_entries;
+    int stlb_ways;
+    bool huge;
+} TlbConfig;
+
+/*
+ * tlb_parse_config - "default" or "l1_entries:l1_ways:stlb_entries:stlb_ways"
+ * Returns -1 if the geometry is invalid (entries must be a multiple of ways).
+ */
+int tlb_parse_config(const char *spec, TlbConfig *cfg);
+
+/*
+ * run_tlb_model - Simulates TLBs + page walks over an LRU pool of @F frames
+ */
+void run_tlb_model(int F, const RefSeq *seq, const TlbConfig *cfg);
+
+/* ============================================================
+ *  prefetch.c
+ * ============================================================ */
+
+/*
+ * run_prefetch_study - Compares FIFO/LRU/Clock with and without read-ahead
+ * and stride prefetching over @F frames
+ * @ra_max : Largest read-ahead window in pages
+ */
+void run_prefetch_study(int F, const RefSeq *seq, int ra_max);
+
+/* ============================================================
+ *  mrc.c
+ * ============================================================ */
+
+/*
+ * run_mrc_study - LRU miss-ratio curve of the binary trace at @path from SHARDS
+ * sampling at @rate (0..1], compared against the exact curve when the trace is
+ * small enough
+ * @from, @to, @step : Cache sizes to report (from = 0: powers of two)
+ */
+int run_mrc_study(const char *path, double rate, int from, int to, int step);
+
+/* ============================================================
+ *  zswap.c
+ * ============================================================ */
+
+/**
+ * ZswapConfig - Compressed tier parameters
+ * - ratio: Average compression ratio (uncompressed / compressed size).
+ * - sampled: Sample each page's compressed size around the ratio instead of
+ *   using it for every page.
+ * - major_us, minor_us: Cost of a disk read / a decompression.
+ */
+typedef struct {
+    double ratio;
+    bool sampled;
+    double major_us;
+    double minor_us;
+} ZswapConfig;
+
+/*
+ * zswap_parse_config - "[~]ratio[:major_us:minor_us]" ("~": per-page sampled ratio)
+ * Returns -1 if the configuration is invalid.
+ */
+int zswap_parse_config(const char *spec, ZswapConfig *cfg);
+
+/*
+ * run_zswap_study - Major / minor faults and effective capacity when part of
+ * the @F frames holds a compressed pool
+ */
+void run_zswap_study(int F, const RefSeq *seq, const ZswapConfig *cfg);
+
+/* ============================================================
+ *  timeline.c
+ * ============================================================ */
+
+/*
+ * run_timeline_report - Windowed fault rates, phase changes and fault bursts
+ * of @npol tasks that recorded a timeline every @window references
+ * @names       : Short policy names, one per task
+ * @export_path : CSV / JSON output file, NULL to print the timeline
+ * Returns 0 on success, -1 if the export file can't be written
+ */
+int run_timeline_report(const RefSeq *seq, int window, const SimTask *tasks,
+                        const char *const *names, int npol, const char *export_path);
+
+/* ============================================================
+ *  refgen.c
+ * ============================================================ */
+
+typedef enum { REFGEN_UNIFORM, REFGEN_ZIPF, REFGEN_LOOP, REFGEN_PHASES } RefGenKind;
+#define REFGEN_KINDS 4
+
+/*
+ * refgen_kind_name - "uniform", "zipf", "loop" or "phases"
+ */
+const char *refgen_kind_name(RefGenKind kind);
+
+/*
+ * refgen_generate - Reproducible synthetic reference string
+ * @n     : Number of references
+ * @pages : Pages are drawn from [0, pages)
+ * @seed  : Generator seed (same seed, same sequence)
+ */
+int refgen_generate(RefSeq *seq, RefGenKind kind, int n, int pages, uint64_t seed);
+
+/* ============================================================
+ *  bench.c
+ * ============================================================ */
+
+/**
+ * BenchOptions - Benchmark parameters
+ * - max_refs: Largest reference string (sizes go 10^3, 10^4, ... up to it).
+ * - from, to, step: Frame counts (from = 0: built-in defaults).
+ */
+typedef struct {
+    int max_refs;
+    int pages;
+    uint64_t seed;
+    int from, to, step;
+} BenchOptions;
+
+/*
+ * run_benchmark - refs/sec and peak RSS of each policy on every synthetic workload
+ * @names, @fns : Policies to measure
+ */
+int run_benchmark(const char *const *names, const SimFn *fns, int npol, const BenchOptions *o);
+
+/* ============================================================
+ *  objcache.c
+ * ============================================================ */
+
+/*
+ * run_object_cache - Variable-size object cache simulation (LRU, LRU-2,
+ * GDSF, size-adjusted LRU) with object and byte hit rates
+ * @path : File with the capacity in bytes followed by "<object> <size>" records
+ */
+int run_object_cache(const char *path);
+
+#endif
@@ -0,0 +1,75 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "page_replacement_simulator.h"
+
+/*
+ * parallel.c
+ *
+ * Worker pool for independent simulations. Every simulate_* call only reads
+ * the shared RefSeq, so each (policy, frame count) pair is a task with its own
+ * result slot. Workers take the next unclaimed task until none are left; the
+ * caller prints the slots in task order, so the output does not depend on
+ * which thread finished first.
+ */
+
+typedef struct {
+    SimTask *tasks;
+    int ntask;
+    int next;               // Index of the next unclaimed task
+    const RefSeq *seq;
+    pthread_mutex_t lock;   // Protects next
+} TaskPool;
+
+static void *worker(void *arg) {
+
+    TaskPool *pool = (TaskPool*)arg;
+
+    while (1) {
+        pthread_mutex_lock(&pool->lock);
+        int i = pool->next++;
+        pthread_mutex_unlock(&pool->lock);
+
+        if (i >= pool->ntask) break;
+
+        SimTask *t = &pool->tasks[i];
+        t->faults = t->fn(t->frames, pool->seq, &t->stats);
+    }
+    return NULL;
+}
+
+int default_threads(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+
+int run_tasks(SimTask *tasks, int ntask, const RefSeq *seq, int nthreads) {
+
+    TaskPool pool = { tasks, ntask, 0, seq, PTHREAD_MUTEX_INITIALIZER };
+
+    if (nthreads > ntask) nthreads = ntask;
+
+    // A single worker runs in the calling thread
+    if (nthreads <= 1) {
+        worker(&pool);
+        return 0;
+    }
+
+    pthread_t *tid = (pthread_t*)malloc(sizeof(pthread_t)*nthreads);
+    int started = 0;
+    for (; started < nthreads; started++) {
+        if (pthread_create(&tid[started], NULL, worker, &pool) != 0) break;
+    }
+    // Whatever could not be handed to a thread is finished here
+    if (started < nthreads) worker(&pool);
+
+    for (int i = 0; i < started; i++) pthread_join(tid[i], NULL);
+
+    free(tid);
+    pthread_mutex_destroy(&pool.lock);
+    return 0;
+}
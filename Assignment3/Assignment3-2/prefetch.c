@@ -0,0 +1,273 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "page_replacement_simulator.h"
+
+/*
+ * prefetch.c
+ *
+ * Prefetching models on top of FIFO, LRU and Clock:
+ *  - Read-ahead: adaptive sequential window in the style of Linux ondemand
+ *    readahead. A miss right after the previous page opens a window of
+ *    RA_INIT_PAGES; touching the first page of a window (the async trigger)
+ *    reads the next window at twice the size, up to the configured maximum.
+ *    Random misses do not read ahead.
+ *  - Stride: once two consecutive references are the same non-zero distance
+ *    apart, the next STRIDE_DEGREE pages along that stride are fetched.
+ *
+ * Each policy is replayed without prefetching (baseline) and with each
+ * prefetcher. A prefetched page is "useful" when a demand reference hits it
+ * before eviction and "polluting" when it is evicted without being used.
+ * OPT is left out: prefetching into an oracle policy is not meaningful.
+ */
+
+#define RA_INIT_PAGES   4
+#define STRIDE_DEGREE   4
+
+typedef enum { POOL_FIFO, POOL_LRU, POOL_CLOCK } PoolPolicy;
+typedef enum { PF_NONE, PF_READAHEAD, PF_STRIDE } Prefetcher;
+
+/**
+ * FramePool - Frames of one policy with an O(1) page index
+ * - map: Page -> frame (-1 once evicted).
+ * - unused[f]: Frame f holds a prefetched page no demand reference has touched yet.
+ * - prev/next/head/tail: LRU list (most recent at head).
+ * - hand: FIFO victim pointer / Clock hand.
+ */
+typedef struct {
+    PoolPolicy policy;
+    int F;
+    int filled;
+    int *page;
+    char *refb;
+    char *unused;
+    int *prev, *next;
+    int head, tail;
+    int hand;
+    PageMap map;
+} FramePool;
+
+/**
+ * PrefetchStats - Result of one replay
+ */
+typedef struct {
+    int faults;
+    int issued;     // Pages brought in by the prefetcher
+    int useful;     // Prefetched pages later hit by a demand reference
+    int polluted;   // Prefetched pages evicted without being used
+} PrefetchStats;
+
+static void pool_init(FramePool *fp, PoolPolicy policy, int F) {
+    fp->policy = policy;
+    fp->F = F;
+    fp->filled = 0;
+    fp->page = (int*)malloc(sizeof(int)*F);
+    fp->refb = (char*)calloc(F, sizeof(char));
+    fp->unused = (char*)calloc(F, sizeof(char));
+    fp->prev = (int*)malloc(sizeof(int)*F);
+    fp->next = (int*)malloc(sizeof(int)*F);
+    fp->head = fp->tail = -1;
+    fp->hand = 0;
+    pagemap_init(&fp->map, F);
+}
+
+static void pool_free(FramePool *fp) {
+    free(fp->page);
+    free(fp->refb);
+    free(fp->unused);
+    free(fp->prev);
+    free(fp->next);
+    pagemap_free(&fp->map);
+}
+
+static int pool_lookup(const FramePool *fp, int page) {
+    int *f = pagemap_get(&fp->map, page);
+    return f ? *f : -1;
+}
+
+static void lru_unlink(FramePool *fp, int f) {
+    if (fp->prev[f] != -1) fp->next[fp->prev[f]] = fp->next[f]; else fp->head = fp->next[f];
+    if (fp->next[f] != -1) fp->prev[fp->next[f]] = fp->prev[f]; else fp->tail = fp->prev[f];
+}
+
+static void lru_push_head(FramePool *fp, int f) {
+    fp->prev[f] = -1;
+    fp->next[f] = fp->head;
+    if (fp->head != -1) fp->prev[fp->head] = f; else fp->tail = f;
+    fp->head = f;
+}
+
+/**
+ * pool_touch - Demand hit on frame f
+ */
+static void pool_touch(FramePool *fp, int f) {
+    if (fp->policy == POOL_LRU) {
+        lru_unlink(fp, f);
+        lru_push_head(fp, f);
+    } else if (fp->policy == POOL_CLOCK) {
+        fp->refb[f] = 1;
+    }
+}
+
+/**
+ * pool_insert - Loads a page, evicting a victim if the pool is full.
+ * @demand: false for a prefetched page (Clock leaves its reference bit clear).
+ */
+static void pool_insert(FramePool *fp, int page, bool demand, PrefetchStats *st) {
+
+    int f;
+    if (fp->filled < fp->F) {
+        f = fp->filled++;
+    } else {
+        switch (fp->policy) {
+        case POOL_FIFO:
+            f = fp->hand;
+            fp->hand = (fp->hand + 1) % fp->F;
+            break;
+        case POOL_LRU:
+            f = fp->tail;
+            lru_unlink(fp, f);
+            break;
+        default: // POOL_CLOCK
+            while (fp->refb[fp->hand]) {
+                fp->refb[fp->hand] = 0;
+                fp->hand = (fp->hand + 1) % fp->F;
+            }
+            f = fp->hand;
+            fp->hand = (fp->hand + 1) % fp->F;
+            break;
+        }
+        *pagemap_get(&fp->map, fp->page[f]) = -1;
+        if (fp->unused[f]) st->polluted++;
+    }
+
+    fp->page[f] = page;
+    fp->refb[f] = demand;
+    fp->unused[f] = !demand;
+    *pagemap_put(&fp->map, page, -1) = f;
+    if (fp->policy == POOL_LRU) lru_push_head(fp, f);
+}
+
+/**
+ * prefetch_range - Prefetches @count pages from @first with the given stride.
+ * At most F - 1 pages are brought in so the demanded page is never pushed out.
+ */
+static void prefetch_range(FramePool *fp, int first, int count, int stride, PrefetchStats *st) {
+    if (count > fp->F - 1) count = fp->F - 1;
+    for (int k = 0; k < count; k++) {
+        long long page = first + (long long)k * stride;
+        if (page < 0 || page > 0x7FFFFFFF) break;
+        if (pool_lookup(fp, (int)page) >= 0) continue;
+        pool_insert(fp, (int)page, false, st);
+        st->issued++;
+    }
+}
+
+static void run_prefetch(PoolPolicy policy, Prefetcher pf, int F, const RefSeq *seq,
+                         int ra_max, PrefetchStats *st) {
+
+    FramePool fp;
+    pool_init(&fp, policy, F);
+    memset(st, 0, sizeof(*st));
+
+    // Read-ahead state
+    int prev_page = -2;
+    int ra_size = 0;        // Size of the current window (0: no stream)
+    int ra_next = -1;       // First page after the current window
+    int ra_trigger = -1;    // Touching this page reads the next window
+
+    // Stride state
+    int s_prev = -1;
+    int s_stride = 0;
+    int s_conf = 0;         // Consecutive repeats of s_stride
+
+    for (int t = 0; t < seq->n; t++) {
+
+        int p = seq->refs[t];
+        int f = pool_lookup(&fp, p);
+
+        if (f >= 0) {
+            // HIT
+            pool_touch(&fp, f);
+            if (fp.unused[f]) {
+                fp.unused[f] = 0;
+                st->useful++;
+            }
+            // Async read-ahead: the stream reached the current window
+            if (pf == PF_READAHEAD && p == ra_trigger) {
+                ra_size = (ra_size * 2 > ra_max) ? ra_max : ra_size * 2;
+                ra_trigger = ra_next;
+                prefetch_range(&fp, ra_next, ra_size, 1, st);
+                ra_next += ra_size;
+            }
+        } else {
+            // MISS
+            st->faults++;
+            pool_insert(&fp, p, true, st);
+
+            if (pf == PF_READAHEAD) {
+                if (p == prev_page + 1) {
+                    // Sequential miss: open (or grow) a window right after p
+                    ra_size = ra_size ? ra_size * 2 : RA_INIT_PAGES;
+                    if (ra_size > ra_max) ra_size = ra_max;
+                    prefetch_range(&fp, p + 1, ra_size, 1, st);
+                    ra_trigger = p + 1;
+                    ra_next = p + 1 + ra_size;
+                } else {
+                    ra_size = 0;
+                    ra_trigger = -1;
+                }
+            }
+        }
+        prev_page = p;
+
+        if (pf == PF_STRIDE && p != s_prev) {
+            int d = p - s_prev;
+            if (s_prev >= 0 && d == s_stride) s_conf++;
+            else {
+                s_stride = d;
+                s_conf = 0;
+            }
+            s_prev = p;
+            if (s_conf >= 1) prefetch_range(&fp, p + s_stride, STRIDE_DEGREE, s_stride, st);
+        }
+    }
+
+    pool_free(&fp);
+}
+
+void run_prefetch_study(int F, const RefSeq *seq, int ra_max) {
+
+    static const struct { const char *name; PoolPolicy policy; } bases[] = {
+        { "FIFO", POOL_FIFO }, { "LRU", POOL_LRU }, { "Clock", POOL_CLOCK },
+    };
+    static const struct { const char *name; Prefetcher pf; } pfs[] = {
+        { "readahead", PF_READAHEAD }, { "stride", PF_STRIDE },
+    };
+
+    printf("Prefetch Study (read-ahead window %d..%d pages, stride degree %d):\n",
+           RA_INIT_PAGES, ra_max, STRIDE_DEGREE);
+    printf("%-6s %-10s %8s %8s %10s %8s %8s %9s %9s %9s\n", "Policy", "Prefetch", "Faults", "Baseline",
+           "Reduction", "Issued", "Useful", "Accuracy", "Coverage", "Polluted");
+
+    for (int b = 0; b < (int)(sizeof(bases) / sizeof(bases[0])); b++) {
+        PrefetchStats base;
+        run_prefetch(bases[b].policy, PF_NONE, F, seq, ra_max, &base);
+
+        for (int k = 0; k < (int)(sizeof(pfs) / sizeof(pfs[0])); k++) {
+            PrefetchStats st;
+            run_prefetch(bases[b].policy, pfs[k].pf, F, seq, ra_max, &st);
+
+            double reduction = base.faults ? (base.faults - st.faults) * 100.0 / base.faults : 0;
+            double accuracy  = st.issued ? st.useful * 100.0 / st.issued : 0;
+            double coverage  = (st.useful + st.faults) ? st.useful * 100.0 / (st.useful + st.faults) : 0;
+            printf("%-6s %-10s %8d %8d %9.2f%% %8d %8d %8.2f%% %8.2f%% %9d\n",
+                   bases[b].name, pfs[k].name, st.faults, base.faults, reduction,
+                   st.issued, st.useful, accuracy, coverage, st.polluted);
+        }
+    }
+    printf("\n");
+}
@@ -0,0 +1,117 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "page_replacement_simulator.h"
+
+/*
+ * refgen.c
+ *
+ * Reproducible synthetic reference strings. Every workload is driven by a
+ * splitmix64 generator seeded explicitly, so the same (kind, n, pages, seed)
+ * always gives the same sequence on every platform.
+ *  - uniform : every page of [0, pages) equally likely
+ *  - zipf    : page i with probability proportional to 1 / (i + 1)^ZIPF_S
+ *  - loop    : sequential scans of [0, pages), over and over
+ *  - phases  : PHASE_COUNT phases, each a Zipf-skewed working set of
+ *              pages / 4 pages at its own offset, mixed with 10% uniform noise
+ */
+
+#define ZIPF_S          1.0
+#define PHASE_COUNT     8
+
+static const char *kind_names[] = { "uniform", "zipf", "loop", "phases" };
+
+const char *refgen_kind_name(RefGenKind kind) {
+    return kind_names[kind];
+}
+
+static uint64_t next_rand(uint64_t *s) {
+    uint64_t z = (*s += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+static double next_unit(uint64_t *s) {  // Uniform [0, 1)
+    return (next_rand(s) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/**
+ * zipf_cdf - Cumulative Zipf probabilities of ranks 0..n-1.
+ */
+static double *zipf_cdf(int n) {
+    double *cdf = (double*)malloc(sizeof(double)*n);
+    double sum = 0;
+    for (int i = 0; i < n; i++) {
+        sum += 1.0 / pow(i + 1, ZIPF_S);
+        cdf[i] = sum;
+    }
+    for (int i = 0; i < n; i++) cdf[i] /= sum;
+    return cdf;
+}
+
+static int zipf_draw(const double *cdf, int n, uint64_t *s) {
+    double u = next_unit(s);
+    int lo = 0, hi = n - 1;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (cdf[mid] < u) lo = mid + 1; else hi = mid;
+    }
+    return lo;
+}
+
+/**
+ * refgen_generate - Fills @seq with @n references to pages in [0, @pages).
+ * Logic:
+ * - Zipf ranks are mapped to pages through a fixed multiplicative scramble,
+ *   so the hot pages are spread over the page range instead of being 0, 1, 2...
+ * Returns -1 if the sequence does not fit in memory.
+ */
+int refgen_generate(RefSeq *seq, RefGenKind kind, int n, int pages, uint64_t seed) {
+
+    seq->n = 0;
+    seq->write = NULL;
+    seq->refs = (int*)malloc(sizeof(int)*(n ? (size_t)n : 1));
+    if (seq->refs == NULL) {
+        fprintf(stderr, "Not enough memory for %d references\n", n);
+        return -1;
+    }
+
+    uint64_t s = seed;
+    int hot = (kind == REFGEN_PHASES) ? (pages / 4 > 0 ? pages / 4 : 1) : pages;
+    double *cdf = (kind == REFGEN_ZIPF || kind == REFGEN_PHASES) ? zipf_cdf(hot) : NULL;
+    int phase_len = n / PHASE_COUNT > 0 ? n / PHASE_COUNT : 1;
+
+    for (int k = 0; k < n; k++) {
+        int p;
+        switch (kind) {
+        case REFGEN_UNIFORM:
+            p = (int)(next_rand(&s) % (uint64_t)pages);
+            break;
+        case REFGEN_ZIPF:
+            p = (int)(((uint64_t)zipf_draw(cdf, hot, &s) * 2654435761u) % (uint64_t)pages);
+            break;
+        case REFGEN_LOOP:
+            p = k % pages;
+            break;
+        default: { // REFGEN_PHASES
+            if (next_unit(&s) < 0.1) {
+                p = (int)(next_rand(&s) % (uint64_t)pages);
+                break;
+            }
+            int base = (int)((long long)(k / phase_len) * pages / PHASE_COUNT);
+            p = (int)((base + (uint64_t)zipf_draw(cdf, hot, &s) * 2654435761u % (uint64_t)hot) % (uint64_t)pages);
+            break;
+        }
+        }
+        seq->refs[k] = p;
+    }
+    seq->n = n;
+    free(cdf);
+    return 0;
+}
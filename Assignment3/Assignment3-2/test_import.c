@@ -0,0 +1,76 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "page_replacement_simulator.h"
+
+/*
+ * test_import.c
+ *
+ * Checks of the page folding done by the trace importers: make test
+ *  - adjacent pages high in the address space stay adjacent
+ *  - pages of different spans don't collide
+ */
+
+static int failures;
+
+/* trace_format.c's text converter needs this; the importers never call it */
+int scan_ref(FILE *fp, int *page, bool *is_write) {
+    (void)fp;
+    (void)page;
+    (void)is_write;
+    return EOF;
+}
+
+static void check(bool ok, const char *what) {
+    printf("%s: %s\n", ok ? "ok  " : "FAIL", what);
+    if (!ok) failures++;
+}
+
+/**
+ * import_lines - Imports @text as a pinatrace capture with 4 KB pages.
+ */
+static int import_lines(const char *text, RefSeq *seq) {
+
+    char path[] = "/tmp/test_importXXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) return -1;
+    FILE *fp = fdopen(fd, "w");
+    fputs(text, fp);
+    fclose(fp);
+
+    ImportOptions o = { IMPORT_PIN, 12, false };
+    int ret = import_to_seq(path, &o, seq);
+    unlink(path);
+    return ret;
+}
+
+int main(void) {
+
+    RefSeq seq;
+
+    // Stack pages 0x7ffc12345 and 0x7ffc12346, then the heap, then the stack again
+    const char *trace =
+        "0x401000: R 0x7ffc12345ff8\n"
+        "0x401004: W 0x7ffc12346000\n"
+        "0x401008: R 0x55d0c0a01010\n"
+        "0x40100c: R 0x55d0c0a02010\n"
+        "0x401010: R 0x7ffc12347000\n";
+    if (import_lines(trace, &seq) != 0 || seq.n != 5) {
+        check(false, "import of a pinatrace capture");
+        return 1;
+    }
+    check(seq.refs[1] == seq.refs[0] + 1, "adjacent stack pages map to consecutive pages");
+    check(seq.refs[4] == seq.refs[0] + 2, "a stride of one page survives a jump to the heap");
+    check(seq.refs[3] == seq.refs[2] + 1, "adjacent heap pages map to consecutive pages");
+    check(seq.refs[2] != seq.refs[0] && seq.refs[2] != seq.refs[1] && seq.refs[2] != seq.refs[4],
+          "heap and stack pages don't collide");
+    check(ref_is_write(&seq, 1) && !ref_is_write(&seq, 0), "store flags are kept");
+    free(seq.refs);
+    free(seq.write);
+
+    printf("%d failure(s)\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,220 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "page_replacement_simulator.h"
+
+/*
+ * timeline.c
+ *
+ * Windowed fault rates over the run of each policy, recorded by the
+ * simulations themselves (SimStats.timeline), plus two analyses on top:
+ *  - Phase changes: the similarity of a window to the previous one is the
+ *    fraction of its references that go to pages the previous window also
+ *    touched. Weighting by references keeps a few stray pages from hiding a
+ *    stable working set; a similarity under PHASE_SIMILARITY means the
+ *    working set shifted.
+ *  - Fault bursts: windows whose fault rate is more than BURST_FACTOR times
+ *    the policy's overall rate. Consecutive burst windows form one burst.
+ * The timeline goes to stdout, or to a CSV / JSON file (by file extension).
+ */
+
+#define PHASE_SIMILARITY    0.5
+#define BURST_FACTOR        2.0
+
+/**
+ * PhaseInfo - Working-set statistics of one window
+ * - distinct: Distinct pages referenced in the window.
+ * - shared: References to pages that were also referenced in the previous window.
+ */
+typedef struct {
+    int distinct;
+    int shared;
+} PhaseInfo;
+
+static int window_refs(const RefSeq *seq, int window, int w) {
+    int end = (w + 1) * window < seq->n ? (w + 1) * window : seq->n;
+    return end - w * window;
+}
+
+static double similarity(const RefSeq *seq, int window, const PhaseInfo *ph, int w) {
+    if (w == 0) return 1.0;
+    return (double)ph[w].shared / window_refs(seq, window, w);
+}
+
+/**
+ * compute_phases - Fills in distinct page / shared reference counts for every window.
+ * Logic:
+ * - seen: Page -> (last window it was referenced in) * 2 + (whether it was
+ *   also referenced in the window before that).
+ * - On the first reference of a page in window w, the low bit is set if the
+ *   page was last seen exactly in w - 1; every reference in w then counts as
+ *   shared according to that bit.
+ */
+static void compute_phases(const RefSeq *seq, int window, int nwin, PhaseInfo *ph) {
+
+    PageMap seen;
+    pagemap_init(&seen, 1024);
+    memset(ph, 0, sizeof(PhaseInfo)*nwin);
+
+    for (int t = 0; t < seq->n; t++) {
+        int w = t / window;
+        int *v = pagemap_get(&seen, seq->refs[t]);
+        if (v == NULL) {
+            pagemap_put(&seen, seq->refs[t], w * 2);
+            ph[w].distinct++;
+            continue;
+        }
+        if (*v / 2 < w) {
+            *v = w * 2 + (*v / 2 == w - 1);
+            ph[w].distinct++;
+        }
+        ph[w].shared += *v & 1;
+    }
+    pagemap_free(&seen);
+}
+
+static int export_csv(FILE *fp, const RefSeq *seq, int window, int nwin, const PhaseInfo *ph,
+                      const SimTask *tasks, const char *const *names, int npol) {
+
+    fprintf(fp, "window,start,refs,distinct,similarity,phase_change");
+    for (int j = 0; j < npol; j++) fprintf(fp, ",%s_faults,%s_rate", names[j], names[j]);
+    fprintf(fp, "\n");
+
+    for (int w = 0; w < nwin; w++) {
+        int refs = window_refs(seq, window, w);
+        double sim = similarity(seq, window, ph, w);
+        fprintf(fp, "%d,%d,%d,%d,%.4f,%d", w, w * window, refs, ph[w].distinct, sim,
+                sim < PHASE_SIMILARITY);
+        for (int j = 0; j < npol; j++)
+            fprintf(fp, ",%d,%.4f", tasks[j].stats.timeline[w], (double)tasks[j].stats.timeline[w] / refs);
+        fprintf(fp, "\n");
+    }
+    return ferror(fp) ? -1 : 0;
+}
+
+static int export_json(FILE *fp, const RefSeq *seq, int window, int nwin, const PhaseInfo *ph,
+                       const SimTask *tasks, const char *const *names, int npol) {
+
+    fprintf(fp, "{\n  \"window\": %d,\n  \"refs\": %d,\n  \"frames\": %d,\n  \"policies\": [",
+            window, seq->n, tasks[0].frames);
+    for (int j = 0; j < npol; j++) fprintf(fp, "%s\"%s\"", j ? ", " : "", names[j]);
+    fprintf(fp, "],\n  \"windows\": [\n");
+
+    for (int w = 0; w < nwin; w++) {
+        double sim = similarity(seq, window, ph, w);
+        fprintf(fp, "    {\"start\": %d, \"refs\": %d, \"distinct\": %d, \"similarity\": %.4f, "
+                "\"phase_change\": %s, \"faults\": [", w * window, window_refs(seq, window, w),
+                ph[w].distinct, sim, sim < PHASE_SIMILARITY ? "true" : "false");
+        for (int j = 0; j < npol; j++) fprintf(fp, "%s%d", j ? ", " : "", tasks[j].stats.timeline[w]);
+        fprintf(fp, "]}%s\n", w + 1 < nwin ? "," : "");
+    }
+    fprintf(fp, "  ]\n}\n");
+    return ferror(fp) ? -1 : 0;
+}
+
+static void print_timeline(const RefSeq *seq, int window, int nwin, const PhaseInfo *ph,
+                           const SimTask *tasks, const char *const *names, int npol) {
+
+    printf("Fault Timeline (window %d refs):\n", window);
+    printf("%10s %8s", "Start", "Distinct");
+    for (int j = 0; j < npol; j++) printf("%9s", names[j]);
+    printf("\n");
+
+    for (int w = 0; w < nwin; w++) {
+        int refs = window_refs(seq, window, w);
+        printf("%10d %8d", w * window, ph[w].distinct);
+        for (int j = 0; j < npol; j++)
+            printf("%8.2f%%", (double)tasks[j].stats.timeline[w] / refs * 100);
+        printf("%s\n", similarity(seq, window, ph, w) < PHASE_SIMILARITY ? "  <- phase change" : "");
+    }
+    printf("\n");
+}
+
+/**
+ * print_bursts - Summarises the fault bursts of each policy.
+ * Logic:
+ * - A window is part of a burst when its fault rate exceeds BURST_FACTOR
+ *   times the policy's overall fault rate.
+ * - Reports the number of bursts, the longest one, the peak window and how
+ *   many bursts start within one window of a phase change.
+ */
+static void print_bursts(const RefSeq *seq, int window, int nwin, const PhaseInfo *ph,
+                         const SimTask *tasks, const char *const *names, int npol) {
+
+    int phases = 0;
+    for (int w = 1; w < nwin; w++) phases += similarity(seq, window, ph, w) < PHASE_SIMILARITY;
+
+    printf("Fault Bursts (rate > %.1fx average, %d phase changes):\n", BURST_FACTOR, phases);
+    printf("%8s %8s %10s %10s %12s %12s\n", "Policy", "Bursts", "Longest", "AtPhase", "PeakRate", "PeakStart");
+
+    for (int j = 0; j < npol; j++) {
+        const int *tl = tasks[j].stats.timeline;
+        double avg = (double)tasks[j].faults / seq->n;
+        int bursts = 0, at_phase = 0, run = 0, longest = 0, peak_w = 0;
+        double peak = -1;
+
+        for (int w = 0; w < nwin; w++) {
+            double rate = (double)tl[w] / window_refs(seq, window, w);
+            if (rate > peak) {
+                peak = rate;
+                peak_w = w;
+            }
+            if (rate > avg * BURST_FACTOR && tl[w] > 0) {
+                if (run++ == 0) {
+                    bursts++;
+                    bool near = (w > 0 && similarity(seq, window, ph, w) < PHASE_SIMILARITY) ||
+                                (w > 1 && similarity(seq, window, ph, w - 1) < PHASE_SIMILARITY);
+                    at_phase += near;
+                }
+                if (run > longest) longest = run;
+            }
+            else run = 0;
+        }
+        printf("%8s %8d %10d %10d %11.2f%% %12d\n", names[j], bursts, longest * window,
+               at_phase, peak * 100, peak_w * window);
+    }
+    printf("\n");
+}
+
+/**
+ * run_timeline_report - Phase detection and timeline output for the first
+ * @npol tasks, whose simulations recorded a timeline with the given window.
+ * Logic:
+ * - Without @export_path the timeline table is printed; with it, the table is
+ *   written to the file (JSON if the name ends in ".json", CSV otherwise).
+ * - The burst summary is always printed.
+ */
+int run_timeline_report(const RefSeq *seq, int window, const SimTask *tasks,
+                        const char *const *names, int npol, const char *export_path) {
+
+    int nwin = (seq->n + window - 1) / window;
+    if (nwin == 0) return 0;
+
+    PhaseInfo *ph = (PhaseInfo*)malloc(sizeof(PhaseInfo)*nwin);
+    compute_phases(seq, window, nwin, ph);
+
+    int ret = 0;
+    if (export_path) {
+        FILE *fp = fopen(export_path, "w");
+        if (fp == NULL) {
+            fprintf(stderr, "Can't open %s\n", export_path);
+            free(ph);
+            return -1;
+        }
+        size_t len = strlen(export_path);
+        bool json = len >= 5 && strcmp(export_path + len - 5, ".json") == 0;
+        ret = json ? export_json(fp, seq, window, nwin, ph, tasks, names, npol)
+                   : export_csv(fp, seq, window, nwin, ph, tasks, names, npol);
+        if (fclose(fp) != 0) ret = -1;
+        if (ret != 0) fprintf(stderr, "Write error on %s\n", export_path);
+        else printf("Timeline of %d windows written to %s\n\n", nwin, export_path);
+    }
+    else print_timeline(seq, window, nwin, ph, tasks, names, npol);
+
+    print_bursts(seq, window, nwin, ph, tasks, names, npol);
+    free(ph);
+    return ret;
+}
@@ -0,0 +1,221 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "page_replacement_simulator.h"
+
+/*
+ * tlb.c
+ *
+ * Two-level TLB (L1 dTLB + STLB) and page-table walk cost in front of an
+ * LRU frame pool. Each reference is translated first:
+ *  - L1 hit   : TLB_L1_CYCLES
+ *  - STLB hit : TLB_L1_CYCLES + TLB_STLB_CYCLES, the entry is copied into L1
+ *  - Miss     : both lookups plus one memory access per page-table level
+ *               (4 levels for 4 KB pages, 3 for 2 MB pages), fills both TLBs
+ * then the data access itself costs MEM_ACCESS_CYCLES, and a page fault adds
+ * FAULT_CYCLES. Evicting the last resident page a TLB entry maps shoots
+ * the entry down.
+ *
+ * In huge-page mode a TLB entry maps a 2 MB region (512 pages) while the
+ * frame pool keeps replacing 4 KB pages, so the mode shows the gain in TLB
+ * reach for the same resident set. The translation of a region stays valid
+ * while any of its pages is resident.
+ */
+
+#define TLB_L1_CYCLES       1
+#define TLB_STLB_CYCLES     7
+#define MEM_ACCESS_CYCLES   100
+#define FAULT_CYCLES        1000000
+#define HUGE_PAGE_SHIFT     9       // 2 MB / 4 KB
+
+/**
+ * TlbLevel - Set-associative TLB with LRU replacement inside each set
+ * - tag[s * ways + w]: Virtual page (or 2 MB region) cached in way w of set s, -1 if invalid.
+ * - stamp: Last use time of each way (smallest = LRU).
+ */
+typedef struct {
+    int sets;
+    int ways;
+    int *tag;
+    long long *stamp;
+    long long lookups;
+    long long hits;
+} TlbLevel;
+
+static void tlb_init(TlbLevel *t, int entries, int ways) {
+    t->sets = entries / ways;
+    t->ways = ways;
+    t->tag = (int*)malloc(sizeof(int)*entries);
+    t->stamp = (long long*)calloc(entries, sizeof(long long));
+    for (int i = 0; i < entries; i++) t->tag[i] = -1;
+    t->lookups = t->hits = 0;
+}
+
+static void tlb_free(TlbLevel *t) {
+    free(t->tag);
+    free(t->stamp);
+}
+
+static int *tlb_set(const TlbLevel *t, int tag) {
+    return &t->tag[((unsigned)tag % (unsigned)t->sets) * t->ways];
+}
+
+static bool tlb_lookup(TlbLevel *t, int tag, long long now) {
+    int *set = tlb_set(t, tag);
+    t->lookups++;
+    for (int w = 0; w < t->ways; w++) {
+        if (set[w] == tag) {
+            t->stamp[&set[w] - t->tag] = now;
+            t->hits++;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void tlb_fill(TlbLevel *t, int tag, long long now) {
+    int *set = tlb_set(t, tag);
+    int victim = 0;
+    for (int w = 0; w < t->ways; w++) {
+        if (set[w] == -1) {
+            victim = w;
+            break;
+        }
+        if (t->stamp[&set[w] - t->tag] < t->stamp[&set[victim] - t->tag]) victim = w;
+    }
+    set[victim] = tag;
+    t->stamp[&set[victim] - t->tag] = now;
+}
+
+static void tlb_invalidate(TlbLevel *t, int tag) {
+    int *set = tlb_set(t, tag);
+    for (int w = 0; w < t->ways; w++)
+        if (set[w] == tag) set[w] = -1;
+}
+
+int tlb_parse_config(const char *spec, TlbConfig *cfg) {
+
+    cfg->l1_entries = 64;
+    cfg->l1_ways = 4;
+    cfg->stlb_entries = 1536;
+    cfg->stlb_ways = 12;
+
+    if (strcmp(spec, "default") != 0 &&
+        sscanf(spec, "%d:%d:%d:%d", &cfg->l1_entries, &cfg->l1_ways,
+               &cfg->stlb_entries, &cfg->stlb_ways) != 4)
+        return -1;
+
+    if (cfg->l1_ways <= 0 || cfg->stlb_ways <= 0 ||
+        cfg->l1_entries < cfg->l1_ways || cfg->l1_entries % cfg->l1_ways != 0 ||
+        cfg->stlb_entries < cfg->stlb_ways || cfg->stlb_entries % cfg->stlb_ways != 0)
+        return -1;
+    return 0;
+}
+
+/**
+ * run_tlb_model - Replays the sequence through the TLBs and an LRU frame pool.
+ * Logic:
+ * - frame: Page -> frame index (-1 once evicted); LRU order is kept in a
+ *   doubly linked list over the frames (most recent at head).
+ * - resident: TLB tag -> pages of that region in the frame pool.
+ * - Translation cost is decided by the TLBs, residency by the frame pool.
+ */
+void run_tlb_model(int F, const RefSeq *seq, const TlbConfig *cfg) {
+
+    int shift = cfg->huge ? HUGE_PAGE_SHIFT : 0;
+    int levels = cfg->huge ? 3 : 4;
+
+    TlbLevel l1, stlb;
+    tlb_init(&l1, cfg->l1_entries, cfg->l1_ways);
+    tlb_init(&stlb, cfg->stlb_entries, cfg->stlb_ways);
+
+    PageMap frame, resident;
+    pagemap_init(&frame, F);
+    pagemap_init(&resident, F);
+    int *fpage = (int*)malloc(sizeof(int)*F);
+    int *prev  = (int*)malloc(sizeof(int)*F);
+    int *next  = (int*)malloc(sizeof(int)*F);
+    int head = -1, tail = -1, filled = 0;
+
+    long long walks = 0, faults = 0;
+    long long cycles = 0;   // Translation + data access, page faults excluded
+
+    for (int t = 0; t < seq->n; t++) {
+
+        int p = seq->refs[t];
+        int tag = p >> shift;
+
+        // Address translation
+        cycles += TLB_L1_CYCLES;
+        if (!tlb_lookup(&l1, tag, t)) {
+            cycles += TLB_STLB_CYCLES;
+            if (!tlb_lookup(&stlb, tag, t)) {
+                walks++;
+                cycles += (long long)levels * MEM_ACCESS_CYCLES;
+                tlb_fill(&stlb, tag, t);
+            }
+            tlb_fill(&l1, tag, t);
+        }
+        cycles += MEM_ACCESS_CYCLES;
+
+        // Frame pool (LRU)
+        int *fr = pagemap_put(&frame, p, -1);
+        int f = *fr;
+        if (f >= 0) {
+            if (prev[f] != -1) next[prev[f]] = next[f]; else head = next[f];
+            if (next[f] != -1) prev[next[f]] = prev[f]; else tail = prev[f];
+        } else {
+            faults++;
+            if (filled < F) {
+                f = filled++;
+            } else {
+                // Evict the LRU page; its translation goes with the region's last page
+                f = tail;
+                tail = prev[f];
+                if (tail != -1) next[tail] = -1; else head = -1;
+                *pagemap_get(&frame, fpage[f]) = -1;
+                int old = fpage[f] >> shift;
+                if (--*pagemap_get(&resident, old) == 0) {
+                    tlb_invalidate(&l1, old);
+                    tlb_invalidate(&stlb, old);
+                }
+            }
+            int *cnt = pagemap_put(&resident, tag, 0);
+            (*cnt)++;
+            fpage[f] = p;
+            *fr = f;
+        }
+        prev[f] = -1;
+        next[f] = head;
+        if (head != -1) prev[head] = f; else tail = f;
+        head = f;
+    }
+
+    int n = seq->n;
+    double l1_rate   = l1.lookups ? (l1.hits * 100.0) / l1.lookups : 0;
+    double stlb_rate = stlb.lookups ? (stlb.hits * 100.0) / stlb.lookups : 0;
+    double fault_rate = n ? (faults * 100.0) / n : 0;
+    double emat_nf = n ? (double)cycles / n : 0;
+    double emat    = n ? (cycles + (double)faults * FAULT_CYCLES) / n : 0;
+
+    printf("TLB Model (LRU frames, %s pages):\n", cfg->huge ? "2 MB" : "4 KB");
+    printf("L1 dTLB: %d entries, %d-way, Hit Rate: %.2f%%\n", cfg->l1_entries, cfg->l1_ways, l1_rate);
+    printf("STLB: %d entries, %d-way, Hit Rate: %.2f%% (of L1 misses)\n",
+           cfg->stlb_entries, cfg->stlb_ways, stlb_rate);
+    printf("Page Walks: %lld (%d levels each)\n", walks, levels);
+    printf("Number of Page Faults: %lld\n", faults);
+    printf("Page Fault Rate: %.2f%%\n", fault_rate);
+    printf("Effective Memory Access Time: %.2f cycles (%.2f cycles excluding page faults)\n\n",
+           emat, emat_nf);
+
+    tlb_free(&l1);
+    tlb_free(&stlb);
+    pagemap_free(&frame);
+    pagemap_free(&resident);
+    free(fpage);
+    free(prev);
+    free(next);
+}
@@ -0,0 +1,355 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "page_replacement_simulator.h"
+
+/*
+ * trace_format.c
+ *
+ * Compact binary trace format for reference strings.
+ *
+ * Layout (all integers little-endian):
+ *  - Header (32 bytes)
+ *      0  magic "PRT1"
+ *      4  u32 version
+ *      8  u32 frames          page frame count (same as the first token of a text input)
+ *     12  u32 block_refs      references per block (the last block may be shorter)
+ *     16  u64 nrefs           total number of references
+ *     24  u32 flags           TRACE_FLAG_WRITES if any reference is a store
+ *     28  u32 crc32 of bytes 0..27
+ *  - Blocks, each one
+ *      u32 nrefs, u32 payload bytes, u32 crc32 of the payload, payload
+ *    The payload holds zigzag varints of v[k] - v[k-1], where v = page << 1 | is_write
+ *    (version 1 traces stored v = page); the first delta of every block is
+ *    taken from 0, so blocks decode independently.
+ */
+
+#define TRACE_MAGIC         "PRT1"
+#define TRACE_VERSION       2
+#define TRACE_FLAG_WRITES   0x1
+#define TRACE_HEADER_SIZE   32
+#define TRACE_BLOCK_HDR     12
+#define TRACE_BLOCK_REFS    65536
+#define VARINT_MAX          10      // Longest encoding of a 64-bit varint
+
+static uint32_t crc_table[256];
+
+static void crc32_init(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        crc_table[i] = c;
+    }
+}
+
+static uint32_t crc32(const unsigned char *p, size_t len) {
+    if (crc_table[1] == 0) crc32_init();
+    uint32_t c = 0xFFFFFFFFu;
+    for (size_t i = 0; i < len; i++) c = crc_table[(c ^ p[i]) & 0xFF] ^ (c >> 8);
+    return c ^ 0xFFFFFFFFu;
+}
+
+static void put_u32(unsigned char *p, uint32_t v) {
+    for (int i = 0; i < 4; i++) p[i] = (unsigned char)(v >> (8 * i));
+}
+
+static void put_u64(unsigned char *p, uint64_t v) {
+    for (int i = 0; i < 8; i++) p[i] = (unsigned char)(v >> (8 * i));
+}
+
+static uint32_t get_u32(const unsigned char *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static uint64_t get_u64(const unsigned char *p) {
+    return (uint64_t)get_u32(p) | (uint64_t)get_u32(p + 4) << 32;
+}
+
+/* ==================================================================
+ 			WRITER
+===================================================================== */
+
+/**
+ * flush_block - Encodes the buffered references as one block.
+ */
+static int flush_block(TraceWriter *w) {
+
+    if (w->nbuf == 0) return 0;
+
+    unsigned char *out = w->payload + TRACE_BLOCK_HDR;
+    size_t len = 0;
+    int64_t prev = 0;
+
+    for (int i = 0; i < w->nbuf; i++) {
+        int64_t d = w->buf[i] - prev;
+        uint64_t z = ((uint64_t)d << 1) ^ (uint64_t)(d >> 63); // zigzag
+        prev = w->buf[i];
+        while (z >= 0x80) {
+            out[len++] = (unsigned char)(z | 0x80);
+            z >>= 7;
+        }
+        out[len++] = (unsigned char)z;
+    }
+
+    put_u32(w->payload, (uint32_t)w->nbuf);
+    put_u32(w->payload + 4, (uint32_t)len);
+    put_u32(w->payload + 8, crc32(out, len));
+
+    if (fwrite(w->payload, 1, TRACE_BLOCK_HDR + len, w->fp) != TRACE_BLOCK_HDR + len) return -1;
+    w->nbuf = 0;
+    return 0;
+}
+
+static void build_header(unsigned char *h, int frames, uint64_t nrefs, uint32_t flags) {
+    memset(h, 0, TRACE_HEADER_SIZE);
+    memcpy(h, TRACE_MAGIC, 4);
+    put_u32(h + 4, TRACE_VERSION);
+    put_u32(h + 8, (uint32_t)frames);
+    put_u32(h + 12, TRACE_BLOCK_REFS);
+    put_u64(h + 16, nrefs);
+    put_u32(h + 24, flags);
+    put_u32(h + 28, crc32(h, 28));
+}
+
+int trace_writer_open(TraceWriter *w, const char *path, int frames) {
+
+    memset(w, 0, sizeof(*w));
+    w->fp = fopen(path, "wb");
+    if (w->fp == NULL) {
+        fprintf(stderr, "Can't open %s\n", path);
+        return -1;
+    }
+    w->frames = frames;
+    w->buf = (int64_t*)malloc(sizeof(int64_t)*TRACE_BLOCK_REFS);
+    w->payload = (unsigned char*)malloc(TRACE_BLOCK_HDR + (size_t)TRACE_BLOCK_REFS * VARINT_MAX);
+
+    // Placeholder header, rewritten with the final count on close
+    unsigned char h[TRACE_HEADER_SIZE];
+    build_header(h, frames, 0, 0);
+    if (fwrite(h, 1, sizeof(h), w->fp) != sizeof(h)) {
+        trace_writer_close(w);
+        return -1;
+    }
+    return 0;
+}
+
+int trace_writer_put(TraceWriter *w, int page, bool is_write) {
+    w->buf[w->nbuf++] = (int64_t)page << 1 | is_write;
+    w->has_writes |= is_write;
+    w->nrefs++;
+    if (w->nbuf == TRACE_BLOCK_REFS) return flush_block(w);
+    return 0;
+}
+
+int trace_writer_close(TraceWriter *w) {
+
+    int ret = 0;
+    if (w->fp == NULL) return -1;
+
+    if (flush_block(w) != 0) ret = -1;
+
+    unsigned char h[TRACE_HEADER_SIZE];
+    build_header(h, w->frames, w->nrefs, w->has_writes ? TRACE_FLAG_WRITES : 0);
+    if (fseek(w->fp, 0, SEEK_SET) != 0 || fwrite(h, 1, sizeof(h), w->fp) != sizeof(h)) ret = -1;
+    if (fclose(w->fp) != 0) ret = -1;
+
+    free(w->buf);
+    free(w->payload);
+    w->fp = NULL;
+    return ret;
+}
+
+/* ==================================================================
+ 			READER
+===================================================================== */
+
+int trace_is_binary(FILE *fp) {
+    char magic[4];
+    size_t got = fread(magic, 1, 4, fp);
+    rewind(fp);
+    return got == 4 && memcmp(magic, TRACE_MAGIC, 4) == 0;
+}
+
+int trace_reader_open(TraceReader *r, const char *path) {
+
+    memset(r, 0, sizeof(*r));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Can't open %s\n", path);
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < TRACE_HEADER_SIZE) {
+        close(fd);
+        fprintf(stderr, "Wrong trace header\n");
+        return -1;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror("mmap");
+        return -1;
+    }
+    posix_madvise(map, st.st_size, POSIX_MADV_SEQUENTIAL);
+
+    const unsigned char *h = (const unsigned char*)map;
+    uint32_t version = get_u32(h + 4);
+    if (memcmp(h, TRACE_MAGIC, 4) != 0 || version < 1 || version > TRACE_VERSION ||
+        get_u32(h + 28) != crc32(h, 28)) {
+        munmap(map, st.st_size);
+        fprintf(stderr, "Wrong trace header\n");
+        return -1;
+    }
+
+    r->base = h;
+    r->size = st.st_size;
+    r->off = TRACE_HEADER_SIZE;
+    r->frames = (int)get_u32(h + 8);
+    r->version = (int)version;
+    r->block_refs = (int)get_u32(h + 12);
+    r->has_writes = version >= 2 && (get_u32(h + 24) & TRACE_FLAG_WRITES);
+    r->nrefs = get_u64(h + 16);
+    return 0;
+}
+
+/**
+ * trace_reader_next - Decodes the next block straight out of the mapping.
+ * Pages go to @out and, if @wout is not NULL, the store flags to @wout.
+ * Returns the number of references stored in @out, 0 at the end of the trace,
+ * or -1 if the block is truncated, fails its checksum or holds more than @max refs.
+ */
+int trace_reader_next(TraceReader *r, int *out, unsigned char *wout, int max) {
+
+    if (r->off == r->size) return 0;
+    if (r->size - r->off < TRACE_BLOCK_HDR) goto corrupt;
+
+    const unsigned char *b = r->base + r->off;
+    uint32_t n   = get_u32(b);
+    uint32_t len = get_u32(b + 4);
+    const unsigned char *p = b + TRACE_BLOCK_HDR;
+
+    if (n > (uint32_t)max || len > r->size - r->off - TRACE_BLOCK_HDR) goto corrupt;
+    if (crc32(p, len) != get_u32(b + 8)) goto corrupt;
+
+    const unsigned char *end = p + len;
+    int64_t prev = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        uint64_t z = 0;
+        int shift = 0;
+        do {
+            if (p == end || shift > 63) goto corrupt;
+            z |= (uint64_t)(*p & 0x7F) << shift;
+            shift += 7;
+        } while (*p++ & 0x80);
+
+        prev += (int64_t)(z >> 1) ^ -(int64_t)(z & 1);
+        int64_t page = (r->version >= 2) ? prev >> 1 : prev;
+        if (prev < 0 || page > 0x7FFFFFFF) goto corrupt;
+        out[i] = (int)page;
+        if (wout) wout[i] = (r->version >= 2) ? (unsigned char)(prev & 1) : 0;
+    }
+    if (p != end) goto corrupt;
+
+    r->off += TRACE_BLOCK_HDR + len;
+    return (int)n;
+
+corrupt:
+    fprintf(stderr, "Corrupt trace block at offset %zu\n", r->off);
+    return -1;
+}
+
+void trace_reader_close(TraceReader *r) {
+    if (r->base) munmap((void*)r->base, r->size);
+    r->base = NULL;
+}
+
+/**
+ * read_trace - Loads a binary trace into a RefSeq.
+ * The header gives the exact length, so the array is allocated once and each
+ * block is decoded from the mapping directly into its place.
+ */
+int read_trace(const char *path, int *frames, RefSeq *seq) {
+
+    TraceReader r;
+    if (trace_reader_open(&r, path) != 0) return -1;
+
+    *frames = r.frames;
+    if (*frames <= 0 || *frames > MAX_FRAMES || r.nrefs > 0x7FFFFFFF) {
+        trace_reader_close(&r);
+        fprintf(stderr, "Wrong input 2\n");
+        return -1;
+    }
+
+    seq->n = 0;
+    seq->refs = (int*)malloc(sizeof(int)*(r.nrefs ? r.nrefs : 1));
+    seq->write = r.has_writes ? (unsigned char*)malloc(r.nrefs) : NULL;
+
+    int got;
+    while ((got = trace_reader_next(&r, seq->refs + seq->n, seq->write ? seq->write + seq->n : NULL,
+                                    (int)(r.nrefs - seq->n))) > 0)
+        seq->n += got;
+
+    trace_reader_close(&r);
+    if (got < 0 || (uint64_t)seq->n != r.nrefs) {
+        if (got == 0) fprintf(stderr, "Truncated trace: %d of %llu refs\n",
+                              seq->n, (unsigned long long)r.nrefs);
+        free(seq->refs);
+        free(seq->write);
+        seq->refs = NULL;
+        seq->write = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * convert_text_trace - Streams a text input file into the binary format.
+ * Only one block is buffered, so inputs of any length convert in bounded memory.
+ */
+int convert_text_trace(const char *in, const char *out) {
+
+    FILE *fp = fopen(in, "r");
+    if (fp == NULL) {
+        fprintf(stderr, "Can't open %s\n", in);
+        return -1;
+    }
+
+    int frames;
+    if (fscanf(fp, "%d", &frames) != 1 || frames <= 0 || frames > MAX_FRAMES) {
+        fclose(fp);
+        fprintf(stderr, "Wrong input\n");
+        return -1;
+    }
+
+    TraceWriter w;
+    if (trace_writer_open(&w, out, frames) != 0) {
+        fclose(fp);
+        return -1;
+    }
+
+    int x, ret = 0;
+    bool wr;
+    while (ret == 0 && scan_ref(fp, &x, &wr) == 1) {
+        if (x < 0) {
+            fprintf(stderr, "Wrong input\n");
+            ret = -1;
+            break;
+        }
+        ret = trace_writer_put(&w, x, wr);
+    }
+    fclose(fp);
+
+    if (trace_writer_close(&w) != 0) ret = -1;
+    if (ret == 0) printf("Converted %llu references to %s\n", (unsigned long long)w.nrefs, out);
+    return ret;
+}
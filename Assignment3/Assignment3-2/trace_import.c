@@ -0,0 +1,251 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "page_replacement_simulator.h"
+
+/*
+ * trace_import.c
+ *
+ * Importers for real memory-access traces. Each line is parsed on its own
+ * (getline), so captures of any size are streamed; the page numbers go
+ * either into a RefSeq or straight into a binary trace (trace_format.c).
+ *
+ * Supported formats:
+ *  - lackey : valgrind --tool=lackey --trace-mem=yes
+ *             " L addr,size" / " S addr,size" / " M addr,size" (instruction
+ *             fetches "I addr,size" are skipped). An access that straddles a
+ *             page boundary references both pages. S and M are stores.
+ *  - perf   : perf script -F ...,addr (the data address must be the last field),
+ *             every sample is treated as a load
+ *  - pin    : pinatrace style "ip: R|W addr" (the address is the last field)
+ *
+ * Page numbers are folded into the 31-bit int page numbers used by RefSeq:
+ * the address space is cut into spans of 2^FOLD_SPAN_BITS pages (64 GB with
+ * 4 KB pages) and each span touched gets its own compact slot, in order of
+ * first use. Page p + 1 of a span becomes fold(p) + 1, so sequential and
+ * strided streams reach the prefetchers intact; pages of different spans
+ * never collide, but spans that touch are not necessarily adjacent.
+ */
+
+#define FOLD_SPAN_BITS  24
+#define FOLD_MAX_SPANS  (1 << (31 - FOLD_SPAN_BITS))
+
+/**
+ * PageFolder - Span -> slot table of one import
+ * - span[k]: Page number >> FOLD_SPAN_BITS of the span in slot k.
+ * - last: Slot of the previous lookup (consecutive accesses share a span).
+ */
+typedef struct {
+    unsigned long long span[FOLD_MAX_SPANS];
+    int n;
+    int last;
+} PageFolder;
+
+typedef int (*RefSink)(void *ctx, int page, bool is_write);
+
+static const char *format_names[] = { "lackey", "perf", "pin" };
+
+int import_parse_format(const char *name) {
+    for (int i = 0; i < (int)(sizeof(format_names) / sizeof(format_names[0])); i++)
+        if (strcmp(name, format_names[i]) == 0) return i;
+    return -1;
+}
+
+/**
+ * fold_page - Page number of @addr in the folded space.
+ * Returns -1 once more than FOLD_MAX_SPANS spans are in use.
+ */
+static int fold_page(PageFolder *f, unsigned long long addr, int shift) {
+    unsigned long long page = addr >> shift;
+    unsigned long long span = page >> FOLD_SPAN_BITS;
+
+    int k = f->last;
+    if (k >= f->n || f->span[k] != span) {
+        for (k = 0; k < f->n && f->span[k] != span; k++);
+        if (k == f->n) {
+            if (f->n == FOLD_MAX_SPANS) return -1;
+            f->span[f->n++] = span;
+        }
+        f->last = k;
+    }
+    return (int)(((unsigned long long)k << FOLD_SPAN_BITS) | (page & ((1ull << FOLD_SPAN_BITS) - 1)));
+}
+
+/**
+ * parse_hex - Parses a hex number (optional 0x prefix) from @s up to @end.
+ * Returns 0 on success, -1 if the text is not entirely hex digits.
+ */
+static int parse_hex(const char *s, const char *end, unsigned long long *out) {
+    if (end - s > 2 && s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) s += 2;
+    if (s == end) return -1;
+
+    unsigned long long v = 0;
+    for (; s < end; s++) {
+        int c = tolower((unsigned char)*s);
+        if (c >= '0' && c <= '9') v = (v << 4) | (unsigned)(c - '0');
+        else if (c >= 'a' && c <= 'f') v = (v << 4) | (unsigned)(c - 'a' + 10);
+        else return -1;
+    }
+    *out = v;
+    return 0;
+}
+
+/**
+ * parse_lackey - " L 04222cac,8" -> address, access size and store flag.
+ * Returns 0 for a data access, -1 for anything else (instruction fetches, banner).
+ */
+static int parse_lackey(const char *line, unsigned long long *addr, unsigned long *size,
+                        bool *is_write) {
+    if (line[0] != ' ') return -1;
+    char op = line[1];
+    if (op != 'L' && op != 'S' && op != 'M') return -1;
+    *is_write = (op != 'L');
+
+    const char *s = line + 2;
+    while (*s == ' ') s++;
+    const char *comma = strchr(s, ',');
+    if (comma == NULL || parse_hex(s, comma, addr) != 0) return -1;
+
+    *size = strtoul(comma + 1, NULL, 10);
+    if (*size == 0) *size = 1;
+    return 0;
+}
+
+/**
+ * parse_last_hex - Takes the address from the last whitespace-separated field.
+ * A field "W" right before the address marks a store (pinatrace).
+ */
+static int parse_last_hex(const char *line, unsigned long long *addr, bool *is_write) {
+    const char *end = line + strlen(line);
+    while (end > line && isspace((unsigned char)end[-1])) end--;
+    const char *s = end;
+    while (s > line && !isspace((unsigned char)s[-1])) s--;
+
+    const char *op = s;
+    while (op > line && isspace((unsigned char)op[-1])) op--;
+    *is_write = (op - line >= 1 && op[-1] == 'W' && (op - line == 1 || isspace((unsigned char)op[-2])));
+
+    return parse_hex(s, end, addr);
+}
+
+/**
+ * import_stream - Feeds every page referenced by the trace at @path to @sink.
+ */
+static int import_stream(const char *path, const ImportOptions *o, RefSink sink, void *ctx) {
+
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL) {
+        fprintf(stderr, "Can't open %s\n", path);
+        return -1;
+    }
+
+    char *line = NULL;
+    size_t linecap = 0;
+    int last = -1;              // Previous page (for collapsing duplicates)
+    bool last_write = false;
+    long long refs = 0, skipped = 0;
+    int ret = 0;
+    PageFolder folder = { .n = 0, .last = 0 };
+
+    while (ret == 0 && getline(&line, &linecap, fp) != -1) {
+
+        unsigned long long addr;
+        unsigned long size = 1;
+        bool wr = false;
+        int ok = (o->format == IMPORT_LACKEY) ? parse_lackey(line, &addr, &size, &wr)
+                                              : parse_last_hex(line, &addr, &wr);
+        if (o->format == IMPORT_PERF) wr = false;
+        if (ok != 0) {
+            skipped++;
+            continue;
+        }
+
+        // One reference per page touched by the access (two if it straddles a boundary)
+        int pages[2] = { fold_page(&folder, addr, o->page_shift),
+                         fold_page(&folder, addr + size - 1, o->page_shift) };
+        if (pages[0] < 0 || pages[1] < 0) {
+            fprintf(stderr, "Trace touches more than %d address spans of %llu pages\n",
+                    FOLD_MAX_SPANS, 1ull << FOLD_SPAN_BITS);
+            ret = -1;
+            break;
+        }
+        int npages = (pages[0] == pages[1]) ? 1 : 2;
+        for (int i = 0; i < npages && ret == 0; i++) {
+            // A store right after a load of the same page is kept so the page gets dirty
+            if (o->collapse && pages[i] == last && (!wr || last_write)) continue;
+            ret = sink(ctx, pages[i], wr);
+            last = pages[i];
+            last_write = wr;
+            refs++;
+        }
+    }
+
+    free(line);
+    fclose(fp);
+    if (ret == 0)
+        fprintf(stderr, "Imported %lld references from %s (%lld lines skipped)\n", refs, path, skipped);
+    return ret;
+}
+
+/**
+ * SeqBuilder - Growing RefSeq (capacity doubles, as in read_input())
+ * The store flags are only allocated once the first store shows up.
+ */
+typedef struct {
+    RefSeq *seq;
+    int cap;
+} SeqBuilder;
+
+static int seq_sink(void *ctx, int page, bool is_write) {
+    SeqBuilder *b = (SeqBuilder*)ctx;
+    RefSeq *seq = b->seq;
+
+    if (seq->n == b->cap) {
+        if (b->cap == 0x7FFFFFFF) {
+            fprintf(stderr, "Trace too long for an in-memory RefSeq, convert it with -C\n");
+            return -1;
+        }
+        b->cap = (b->cap > 0x3FFFFFFF) ? 0x7FFFFFFF : b->cap * 2;
+        seq->refs = (int*)realloc(seq->refs, sizeof(int)*b->cap);
+        if (seq->write) seq->write = (unsigned char*)realloc(seq->write, b->cap);
+    }
+    if (is_write && seq->write == NULL) seq->write = (unsigned char*)calloc(b->cap, 1);
+    if (seq->write) seq->write[seq->n] = is_write;
+    seq->refs[seq->n++] = page;
+    return 0;
+}
+
+static int writer_sink(void *ctx, int page, bool is_write) {
+    return trace_writer_put((TraceWriter*)ctx, page, is_write);
+}
+
+int import_to_seq(const char *path, const ImportOptions *o, RefSeq *seq) {
+
+    SeqBuilder b = { seq, 128 };
+    seq->n = 0;
+    seq->refs = (int*)malloc(sizeof(int)*b.cap);
+    seq->write = NULL;
+    if (import_stream(path, o, seq_sink, &b) != 0) {
+        free(seq->refs);
+        free(seq->write);
+        seq->refs = NULL;
+        seq->write = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+int import_to_trace(const char *path, const ImportOptions *o, int frames, const char *out) {
+
+    TraceWriter w;
+    if (trace_writer_open(&w, out, frames) != 0) return -1;
+
+    int ret = import_stream(path, o, writer_sink, &w);
+    if (trace_writer_close(&w) != 0) ret = -1;
+    if (ret == 0) printf("Converted %llu references to %s\n", (unsigned long long)w.nrefs, out);
+    return ret;
+}
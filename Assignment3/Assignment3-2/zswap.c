@@ -0,0 +1,264 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "page_replacement_simulator.h"
+
+/*
+ * zswap.c
+ *
+ * Compressed second tier (zswap / zram style) between the RAM frames and
+ * the swap device. Part of the F frames is given to a compressed pool:
+ *  - A page evicted from the LRU RAM frames is compressed into the pool.
+ *    Pages that compress to more than ZSWAP_REJECT_BYTES go straight to disk.
+ *  - The pool is kept in insertion order by bytes. When it is full, its
+ *    oldest entries are written back to disk.
+ *  - A reference to a page in the pool is a minor fault. The page is
+ *    decompressed back into RAM and leaves the pool (exclusive load).
+ *  - A reference to a page in neither tier is a major fault (disk read).
+ * The compressed size is either PAGE_BYTES / ratio for every page, or
+ * sampled once per page (hash of the page number) between 0.25x and 1.75x
+ * of that size, so a page always compresses the same way.
+ */
+
+#define PAGE_BYTES          4096
+#define ZSWAP_REJECT_BYTES  (PAGE_BYTES * 3 / 4)    // Poorly compressible pages bypass the pool
+
+/**
+ * ZPool - Compressed pool, entries in insertion order (oldest at head)
+ * - map: Page -> entry slot.
+ * - Free slots are chained through next[] from free_slot.
+ */
+typedef struct {
+    long long cap;      // Bytes
+    long long used;
+    int *page;
+    int *size;
+    int *prev, *next;
+    int head, tail;
+    int slots;          // Slots handed out so far
+    int slot_cap;
+    int free_slot;
+    int live;
+    PageMap map;
+} ZPool;
+
+/**
+ * ZswapStats - Result of one configuration
+ */
+typedef struct {
+    long long major;        // Disk reads
+    long long minor;        // Decompressions from the pool
+    long long stored;       // Pages compressed into the pool
+    long long rejected;     // Evicted pages too large for the pool
+    long long written;      // Pool entries written back to disk
+    double avg_pool_pages;  // Pages held by the pool, averaged over the references
+} ZswapStats;
+
+int zswap_parse_config(const char *spec, ZswapConfig *cfg) {
+
+    cfg->sampled = (spec[0] == '~');
+    if (cfg->sampled) spec++;
+    cfg->major_us = 100;
+    cfg->minor_us = 3;
+
+    int n = sscanf(spec, "%lf:%lf:%lf", &cfg->ratio, &cfg->major_us, &cfg->minor_us);
+    if (n != 1 && n != 3) return -1;
+    if (cfg->ratio < 1 || cfg->major_us < 0 || cfg->minor_us < 0) return -1;
+    return 0;
+}
+
+/**
+ * compressed_size - Bytes page @page takes in the pool.
+ */
+static int compressed_size(const ZswapConfig *cfg, int page) {
+
+    double size = PAGE_BYTES / cfg->ratio;
+    if (cfg->sampled) {
+        // splitmix64 finaliser -> uniform [0, 1)
+        uint64_t h = (uint64_t)(unsigned)page + 0x9E3779B97F4A7C15ull;
+        h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ull;
+        h = (h ^ (h >> 27)) * 0x94D049BB133111EBull;
+        h ^= h >> 31;
+        size *= 0.25 + 1.5 * ((h >> 11) * (1.0 / 9007199254740992.0));
+    }
+    return size < 1 ? 1 : (int)size;
+}
+
+static void zpool_init(ZPool *z, long long cap) {
+    memset(z, 0, sizeof(*z));
+    z->cap = cap;
+    z->head = z->tail = -1;
+    z->free_slot = -1;
+    pagemap_init(&z->map, 64);
+}
+
+static void zpool_free(ZPool *z) {
+    free(z->page);
+    free(z->size);
+    free(z->prev);
+    free(z->next);
+    pagemap_free(&z->map);
+}
+
+static void zpool_unlink(ZPool *z, int e) {
+    if (z->prev[e] != -1) z->next[z->prev[e]] = z->next[e]; else z->head = z->next[e];
+    if (z->next[e] != -1) z->prev[z->next[e]] = z->prev[e]; else z->tail = z->prev[e];
+    *pagemap_get(&z->map, z->page[e]) = -1;
+    z->used -= z->size[e];
+    z->live--;
+    z->next[e] = z->free_slot;
+    z->free_slot = e;
+}
+
+/**
+ * zpool_take - Removes @page from the pool if it is there.
+ * Returns true on a pool hit.
+ */
+static bool zpool_take(ZPool *z, int page) {
+    int *e = pagemap_get(&z->map, page);
+    if (e == NULL || *e < 0) return false;
+    zpool_unlink(z, *e);
+    return true;
+}
+
+/**
+ * zpool_store - Appends a compressed page, writing back the oldest entries
+ * until it fits. Returns false if the page can't be stored at all.
+ */
+static bool zpool_store(ZPool *z, int page, int size, ZswapStats *st) {
+
+    if (size > ZSWAP_REJECT_BYTES || size > z->cap) return false;
+
+    while (z->used + size > z->cap) {
+        zpool_unlink(z, z->head);
+        st->written++;
+    }
+
+    int e = z->free_slot;
+    if (e >= 0) z->free_slot = z->next[e];
+    else {
+        if (z->slots == z->slot_cap) {
+            int cap = z->slot_cap = z->slot_cap ? z->slot_cap * 2 : 64;
+            z->page = (int*)realloc(z->page, sizeof(int)*cap);
+            z->size = (int*)realloc(z->size, sizeof(int)*cap);
+            z->prev = (int*)realloc(z->prev, sizeof(int)*cap);
+            z->next = (int*)realloc(z->next, sizeof(int)*cap);
+        }
+        e = z->slots++;
+    }
+
+    z->page[e] = page;
+    z->size[e] = size;
+    z->prev[e] = z->tail;
+    z->next[e] = -1;
+    if (z->tail != -1) z->next[z->tail] = e; else z->head = e;
+    z->tail = e;
+    z->used += size;
+    z->live++;
+    *pagemap_put(&z->map, page, -1) = e;
+    return true;
+}
+
+/**
+ * simulate_zswap - LRU over @ram frames backed by a pool of @pool_frames frames.
+ * Logic:
+ * - frame: Page -> RAM frame (-1 once evicted), LRU list over the frames.
+ * - MISS: a pool hit is a minor fault, anything else a major fault. When RAM
+ *   is full, its LRU page is compressed into the pool (or dropped to disk).
+ */
+static void simulate_zswap(int ram, int pool_frames, const RefSeq *seq, const ZswapConfig *cfg,
+                           ZswapStats *st) {
+
+    int *fpage = (int*)malloc(sizeof(int)*ram);
+    int *prev  = (int*)malloc(sizeof(int)*ram);
+    int *next  = (int*)malloc(sizeof(int)*ram);
+    int head = -1, tail = -1, filled = 0;
+    PageMap frame;
+    pagemap_init(&frame, ram);
+    ZPool z;
+    zpool_init(&z, (long long)pool_frames * PAGE_BYTES);
+    memset(st, 0, sizeof(*st));
+    double pool_sum = 0;
+
+    for (int t = 0; t < seq->n; t++) {
+
+        int p = seq->refs[t];
+        int *fr = pagemap_put(&frame, p, -1);
+        int f = *fr;
+
+        if (f >= 0) {
+            if (prev[f] != -1) next[prev[f]] = next[f]; else head = next[f];
+            if (next[f] != -1) prev[next[f]] = prev[f]; else tail = prev[f];
+        } else {
+            if (zpool_take(&z, p)) st->minor++;
+            else st->major++;
+
+            if (filled < ram) f = filled++;
+            else {
+                // Evict the LRU page into the compressed tier
+                f = tail;
+                tail = prev[f];
+                if (tail != -1) next[tail] = -1; else head = -1;
+                *pagemap_get(&frame, fpage[f]) = -1;
+
+                if (pool_frames > 0) {
+                    if (zpool_store(&z, fpage[f], compressed_size(cfg, fpage[f]), st)) st->stored++;
+                    else st->rejected++;
+                }
+            }
+            fpage[f] = p;
+            *pagemap_get(&frame, p) = f;
+        }
+
+        prev[f] = -1;
+        next[f] = head;
+        if (head != -1) prev[head] = f; else tail = f;
+        head = f;
+        pool_sum += z.live;
+    }
+
+    st->avg_pool_pages = seq->n ? pool_sum / seq->n : 0;
+    free(fpage);
+    free(prev);
+    free(next);
+    pagemap_free(&frame);
+    zpool_free(&z);
+}
+
+/**
+ * run_zswap_study - Gives a growing share of the @F frames to the compressed pool.
+ * Logic:
+ * - Share 0% is plain LRU over F frames, the baseline.
+ * - Effective frames = RAM frames + pages held by the pool (averaged over the run).
+ * - Stall time = major faults x major cost + minor faults x decompression cost.
+ */
+void run_zswap_study(int F, const RefSeq *seq, const ZswapConfig *cfg) {
+
+    static const int shares[] = { 0, 10, 20, 30, 50 };
+
+    printf("Compressed Tier Study (%s ratio %.2f, major fault %.0f us, decompression %.1f us):\n",
+           cfg->sampled ? "per-page sampled" : "fixed", cfg->ratio, cfg->major_us, cfg->minor_us);
+    printf("%6s %5s %5s %10s %10s %9s %9s %9s %10s %12s\n", "Share", "RAM", "Pool", "Major", "Minor",
+           "Stored", "Rejected", "Written", "Effective", "Stall(ms)");
+
+    double base_stall = 0;
+    for (int i = 0; i < (int)(sizeof(shares) / sizeof(shares[0])); i++) {
+        int pool = (int)((long long)F * shares[i] / 100);
+        if (i > 0 && (pool == 0 || pool >= F)) continue;
+
+        ZswapStats st;
+        simulate_zswap(F - pool, pool, seq, cfg, &st);
+        double stall = (st.major * cfg->major_us + st.minor * cfg->minor_us) / 1000;
+        if (i == 0) base_stall = stall;
+
+        printf("%5d%% %5d %5d %10lld %10lld %9lld %9lld %9lld %10.1f %12.2f", shares[i], F - pool, pool,
+               st.major, st.minor, st.stored, st.rejected, st.written, F - pool + st.avg_pool_pages, stall);
+        if (i > 0 && base_stall > 0) printf(" (%+.1f%%)", (stall - base_stall) * 100 / base_stall);
+        printf("\n");
+    }
+    printf("\n");
+}
@@ -0,0 +1,442 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/uio.h>
+
+#include "bcache.h"
+
+/*
+ * bcache.c
+ *
+ * A fixed number of block-sized frames caches the data region of the
+ * image, so memory stays bounded however large the image is.
+ *  - Lookup: block number -> frame through a chained hash table.
+ *  - Eviction: CLOCK. A hit sets the frame's reference bit, the hand
+ *    clears it on its way, and the first unpinned frame found without it
+ *    is reused. Read-ahead frames start unreferenced, so a prefetch that
+ *    is never used is the first to go.
+ *  - Write-back: bc_put marks frames dirty; a dirty frame is written when
+ *    it is evicted or by bc_flush, sorted by block so that adjacent blocks
+ *    go out in one writev.
+ * One mutex guards the table and the frame states; the disk I/O itself
+ * runs with it released, the frame pinned and marked LOADING / WRITING so
+ * that other users of the block wait for it.
+ */
+
+#define BC_NONE		0xFFFFFFFFu
+#define BC_BATCH	64		// Frames per writev / read-ahead read
+
+enum { F_EMPTY, F_LOADING, F_VALID, F_WRITING };
+
+/**
+ * Frame - One cached block
+ */
+typedef struct{
+	uint32_t block;		// BC_NONE while empty
+	int32_t  next;		// Hash chain, -1 ends it
+	uint32_t pins;		// bc_get calls not yet put
+	uint8_t  state;
+	uint8_t  ref;		// CLOCK reference bit
+	uint8_t  dirty;
+	uint8_t  ahead;		// Read ahead and not used yet
+}Frame;
+
+static Frame *frames;
+static char *buffers;		// nframes * bsize bytes, frame i at i * bsize
+static uint32_t nframes, hand;
+static int32_t *heads;		// Hash buckets, -1 = empty
+static uint32_t hmask;
+
+static int bc_fd = -1;
+static uint64_t bc_base;	// Image offset of block 0
+static uint32_t bsize, nblocks;
+
+static pthread_mutex_t bc_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t bc_cond = PTHREAD_COND_INITIALIZER;	// A frame was unpinned or finished I/O
+static FatCacheStats stats;
+
+static uint32_t hash_block(uint32_t b){
+	return (b * 2654435761u) & hmask;
+}
+
+static char *frame_data(int i){
+	return buffers + (size_t)i * bsize;
+}
+
+static off_t block_offset(uint32_t b){
+	return (off_t)(bc_base + (uint64_t)b * bsize);
+}
+
+static int lookup(uint32_t b){
+
+	int i = heads[hash_block(b)];
+	while(i >= 0 && frames[i].block != b) i = frames[i].next;
+	return i;
+}
+
+static void hash_insert(int i, uint32_t b){
+
+	uint32_t h = hash_block(b);
+	frames[i].block = b;
+	frames[i].next = heads[h];
+	heads[h] = i;
+}
+
+static void hash_remove(int i){
+
+	int32_t *p = &heads[hash_block(frames[i].block)];
+	while(*p != i) p = &frames[*p].next;
+	*p = frames[i].next;
+	frames[i].block = BC_NONE;
+	frames[i].state = F_EMPTY;
+}
+
+static int pread_all(void *buf, size_t len, off_t off){
+
+	char *p = buf;
+	while(len > 0){
+		ssize_t r = pread(bc_fd, p, len, off);
+		if(r <= 0) return -1;
+		p += r;
+		off += r;
+		len -= r;
+	}
+	return 0;
+}
+
+/**
+ * write_back - Writes dirty frame @i to its block
+ * Drops bc_lock for the write; the frame is pinned and WRITING meanwhile.
+ */
+static int write_back(int i){
+
+	Frame *f = &frames[i];
+	f->state = F_WRITING;
+	f->pins++;
+	pthread_mutex_unlock(&bc_lock);
+
+	const char *p = frame_data(i);
+	size_t left = bsize;
+	off_t off = block_offset(f->block);
+	int err = 0;
+	while(left > 0 && !err){
+		ssize_t w = pwrite(bc_fd, p, left, off);
+		if(w < 0) err = -1;
+		else{
+			p += w;
+			off += w;
+			left -= w;
+		}
+	}
+
+	pthread_mutex_lock(&bc_lock);
+	f->pins--;
+	f->state = F_VALID;
+	if(!err){
+		f->dirty = 0;
+		stats.writebacks++;
+	}
+	pthread_cond_broadcast(&bc_cond);
+	return err;
+}
+
+/**
+ * grab_frame - Picks a frame to reuse (CLOCK)
+ * Pinned and busy frames are skipped, referenced ones get a second chance,
+ * a dirty victim is written back first. With @wait set it sleeps until a
+ * frame is unpinned when all of them are, otherwise it gives up.
+ * Called with bc_lock held. Returns an EMPTY frame, or -1.
+ */
+static int grab_frame(int wait){
+
+	for(;;){
+		for(uint32_t n = 0; n < 2 * nframes; n++){
+			int i = hand;
+			Frame *f = &frames[i];
+			hand = (hand + 1) % nframes;
+
+			if(f->state == F_EMPTY) return i;
+			if(f->pins > 0 || f->state != F_VALID) continue;
+			if(f->ref){
+				f->ref = 0;
+				continue;
+			}
+			if(f->dirty && (write_back(i) != 0 || f->pins > 0 || f->ref || f->state != F_VALID)) continue;
+			hash_remove(i);
+			stats.evictions++;
+			return i;
+		}
+		if(!wait) return -1;
+		pthread_cond_wait(&bc_cond, &bc_lock);
+	}
+}
+
+/**
+ * bc_init - Sets up a cache of about @bytes over the blocks of @fd at @base
+ * The size is raised to the frames a full set of handles can pin at once.
+ */
+int bc_init(int fd, uint64_t base, uint32_t block_size, uint32_t num_blocks, size_t bytes){
+
+	uint64_t n = bytes / block_size;
+	if(n < BC_MIN_FRAMES) n = BC_MIN_FRAMES;
+	if(n > num_blocks) n = num_blocks;
+
+	nframes = (uint32_t)n;
+	for(hmask = 1; hmask < 2 * nframes; hmask <<= 1);
+	frames = (Frame*)malloc(sizeof(Frame) * nframes);
+	heads = (int32_t*)malloc(sizeof(int32_t) * hmask);
+	if(frames == NULL || heads == NULL ||
+	   posix_memalign((void**)&buffers, 4096, (size_t)nframes * block_size) != 0){
+		free(frames);
+		free(heads);
+		frames = NULL;
+		heads = NULL;
+		return FAT_EIO;
+	}
+	hmask--;
+	memset(heads, 0xFF, sizeof(int32_t) * (hmask + 1));
+	for(uint32_t i = 0; i < nframes; i++){
+		memset(&frames[i], 0, sizeof(Frame));
+		frames[i].block = BC_NONE;
+		frames[i].next = -1;
+	}
+
+	hand = 0;
+	bc_fd = fd;
+	bc_base = base;
+	bsize = block_size;
+	nblocks = num_blocks;
+	memset(&stats, 0, sizeof(stats));
+	return FAT_OK;
+}
+
+/**
+ * bc_destroy - Frees the cache; dirty frames are lost, so bc_flush first
+ */
+void bc_destroy(void){
+
+	free(frames);
+	free(heads);
+	free(buffers);
+	frames = NULL;
+	heads = NULL;
+	buffers = NULL;
+	bc_fd = -1;
+}
+
+/**
+ * bc_get - Pins @block in a frame and returns its buffer
+ * Logic:
+ * - A hit waits for the frame to finish loading or writing back.
+ * - A miss takes a frame from grab_frame and, for BC_READ, reads the block
+ *   with the lock released while other users of the block wait.
+ * *frame is what bc_put wants back.
+ */
+char *bc_get(uint32_t block, int mode, int *frame){
+
+	pthread_mutex_lock(&bc_lock);
+	for(;;){
+		int i = lookup(block);
+		if(i >= 0){
+			Frame *f = &frames[i];
+			if(f->state != F_VALID){
+				pthread_cond_wait(&bc_cond, &bc_lock);
+				continue;
+			}
+			f->pins++;
+			f->ref = 1;
+			stats.hits++;
+			if(f->ahead){
+				stats.prefetch_hits++;
+				f->ahead = 0;
+			}
+			if(mode == BC_NEW) memset(frame_data(i), 0, bsize);
+			pthread_mutex_unlock(&bc_lock);
+			*frame = i;
+			return frame_data(i);
+		}
+
+		i = grab_frame(1);
+		if(lookup(block) >= 0) continue;	// Loaded by another thread while we wrote back
+
+		Frame *f = &frames[i];
+		hash_insert(i, block);
+		f->pins = 1;
+		f->ref = 1;
+		f->dirty = 0;
+		f->ahead = 0;
+		stats.misses++;
+		*frame = i;
+		if(mode != BC_READ){
+			if(mode == BC_NEW) memset(frame_data(i), 0, bsize);
+			f->state = F_VALID;
+			pthread_mutex_unlock(&bc_lock);
+			return frame_data(i);
+		}
+
+		f->state = F_LOADING;
+		pthread_mutex_unlock(&bc_lock);
+		int err = pread_all(frame_data(i), bsize, block_offset(block));
+		pthread_mutex_lock(&bc_lock);
+		if(err != 0){
+			hash_remove(i);
+			f->pins = 0;
+		}
+		else f->state = F_VALID;
+		pthread_cond_broadcast(&bc_cond);
+		pthread_mutex_unlock(&bc_lock);
+		return err != 0 ? NULL : frame_data(i);
+	}
+}
+
+void bc_put(int frame, int dirty){
+
+	pthread_mutex_lock(&bc_lock);
+	Frame *f = &frames[frame];
+	if(dirty) f->dirty = 1;
+	if(--f->pins == 0) pthread_cond_broadcast(&bc_cond);
+	pthread_mutex_unlock(&bc_lock);
+}
+
+/**
+ * bc_readahead - Starts caching @blocks, in the order given
+ * Blocks already cached are skipped, and it stops when no frame is free
+ * without waiting. Physically adjacent blocks are read with one pread.
+ */
+void bc_readahead(const uint32_t *blocks, int n){
+
+	int got[BC_BATCH];
+	char *run = NULL;
+
+	for(int done = 0; done < n; ){
+		int want = n - done < BC_BATCH ? n - done : BC_BATCH;
+		int k = 0;
+		pthread_mutex_lock(&bc_lock);
+		for(; want > 0; done++, want--){
+			if(blocks[done] >= nblocks || lookup(blocks[done]) >= 0) continue;
+			int i = grab_frame(0);
+			if(i < 0) break;
+			hash_insert(i, blocks[done]);
+			frames[i].state = F_LOADING;
+			frames[i].pins = 1;
+			frames[i].ref = 0;
+			frames[i].dirty = 0;
+			frames[i].ahead = 1;
+			got[k++] = i;
+		}
+		int stalled = want > 0;
+		pthread_mutex_unlock(&bc_lock);
+		if(k == 0 && stalled) break;
+
+		// One pread per run of adjacent blocks, through a bounce buffer
+		int ok[BC_BATCH];
+		for(int a = 0; a < k; ){
+			int b = a + 1;
+			while(b < k && frames[got[b]].block == frames[got[b - 1]].block + 1) b++;
+			if(b - a == 1) ok[a] = pread_all(frame_data(got[a]), bsize, block_offset(frames[got[a]].block)) == 0;
+			else{
+				if(run == NULL) run = (char*)malloc((size_t)BC_BATCH * bsize);
+				int good = run != NULL &&
+				           pread_all(run, (size_t)(b - a) * bsize, block_offset(frames[got[a]].block)) == 0;
+				for(int c = a; c < b; c++){
+					ok[c] = good;
+					if(good) memcpy(frame_data(got[c]), run + (size_t)(c - a) * bsize, bsize);
+				}
+			}
+			a = b;
+		}
+
+		pthread_mutex_lock(&bc_lock);
+		for(int c = 0; c < k; c++){
+			Frame *f = &frames[got[c]];
+			f->pins = 0;
+			if(ok[c]){
+				f->state = F_VALID;
+				stats.prefetched++;
+			}
+			else hash_remove(got[c]);
+		}
+		pthread_cond_broadcast(&bc_cond);
+		pthread_mutex_unlock(&bc_lock);
+		if(stalled) break;
+	}
+	free(run);
+}
+
+static int cmp_frame_block(const void *a, const void *b){
+	uint32_t x = frames[*(const int*)a].block, y = frames[*(const int*)b].block;
+	return (x > y) - (x < y);
+}
+
+/**
+ * bc_flush - Writes every dirty frame back and waits for the disk
+ * Only called while no other thread uses the cache (fat_sync holds the
+ * image exclusively). Returns 0, or -1 if a write failed.
+ */
+int bc_flush(void){
+
+	pthread_mutex_lock(&bc_lock);
+	int *list = (int*)malloc(sizeof(int) * (nframes ? nframes : 1));
+	if(list == NULL){
+		pthread_mutex_unlock(&bc_lock);
+		return -1;
+	}
+	uint32_t n = 0;
+	for(uint32_t i = 0; i < nframes; i++){
+		if(frames[i].state == F_VALID && frames[i].dirty) list[n++] = i;
+	}
+	qsort(list, n, sizeof(int), cmp_frame_block);
+
+	int err = 0;
+	for(uint32_t a = 0; a < n && !err; ){
+		struct iovec iov[BC_BATCH];
+		uint32_t b = a;
+		do{
+			iov[b - a].iov_base = frame_data(list[b]);
+			iov[b - a].iov_len = bsize;
+			b++;
+		}while(b < n && b - a < BC_BATCH && frames[list[b]].block == frames[list[b - 1]].block + 1);
+
+		if(lseek(bc_fd, block_offset(frames[list[a]].block), SEEK_SET) < 0) err = -1;
+		struct iovec *v = iov;
+		int cnt = b - a;
+		while(!err && cnt > 0){
+			ssize_t w = writev(bc_fd, v, cnt);
+			if(w < 0){
+				err = -1;
+				break;
+			}
+			while(cnt > 0 && (size_t)w >= v->iov_len){
+				w -= v->iov_len;
+				v++;
+				cnt--;
+			}
+			if(cnt > 0){
+				v->iov_base = (char*)v->iov_base + w;
+				v->iov_len -= w;
+			}
+		}
+		for(uint32_t c = a; c < b && !err; c++) frames[list[c]].dirty = 0;
+		if(!err) stats.writebacks += b - a;
+		a = b;
+	}
+	free(list);
+	pthread_mutex_unlock(&bc_lock);
+	if(!err && n > 0 && fdatasync(bc_fd) != 0) err = -1;
+	return err;
+}
+
+void bc_stats(FatCacheStats *st){
+
+	pthread_mutex_lock(&bc_lock);
+	*st = stats;
+	st->frames = nframes;
+	st->dirty = 0;
+	for(uint32_t i = 0; i < nframes; i++) st->dirty += frames[i].dirty;
+	pthread_mutex_unlock(&bc_lock);
+}
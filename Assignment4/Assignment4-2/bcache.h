@@ -0,0 +1,41 @@
+#ifndef BCACHE_H
+#define BCACHE_H
+/*
+ * bcache.h
+ *
+ * Block cache between the FAT library and the data region of the image
+ *
+ * This file declares:
+ *  - setting the cache up over an open image and tearing it down
+ *  - pinning a block in memory and releasing it (clean or dirty)
+ *  - read-ahead of blocks the caller expects to need
+ *  - writing every dirty block back
+ *
+ * Source files using this header:
+ *  - bcache.c  (the cache)
+ *  - fatfs.c   (file data goes through it)
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "fat.h"
+
+#define BC_PIN_MAX		16	// Most frames one library call keeps pinned
+#define BC_MIN_FRAMES	((FAT_MAX_OPEN + 1) * BC_PIN_MAX)	// Enough for every handle at once
+
+/* bc_get modes */
+#define BC_READ		0	// The block's contents are needed
+#define BC_OVERWRITE	1	// The caller replaces the whole block
+#define BC_NEW		2	// Newly allocated: starts zeroed
+
+int  bc_init(int fd, uint64_t base, uint32_t block_size, uint32_t num_blocks, size_t bytes);
+void bc_destroy(void);
+
+char *bc_get(uint32_t block, int mode, int *frame);	// Pinned buffer, NULL on an I/O error
+void bc_put(int frame, int dirty);					// Unpins what bc_get returned
+void bc_readahead(const uint32_t *blocks, int n);	// Loads the ones not cached, without waiting for frames
+int  bc_flush(void);								// Writes every dirty block back, then fdatasync
+void bc_stats(FatCacheStats *st);
+
+#endif
@@ -0,0 +1,240 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "fat.h"
+
+/*
+ * bench.c
+ *
+ * Multi-threaded stress benchmark of the FAT library: ./fat bench [threads]
+ * Formats a scratch image (BENCH_IMAGE), fills BENCH_FILES shared files and
+ * runs every workload with 1, 2, 4 ... threads. The total number of
+ * operations is fixed, split evenly over the threads, so the speedup
+ * column shows how well the locking scales.
+ *  - read  : fat_pread of a random BENCH_IO chunk of a random shared file
+ *  - mixed : 70% read as above, 20% overwrite of a random shared chunk,
+ *            10% append of BENCH_APPEND bytes to the thread's own file
+ *  - meta  : create, write BENCH_IO, stat and delete a file of the thread
+ * Every operation opens and closes its own handle, like a server request.
+ */
+
+#define BENCH_IMAGE		"fat_bench.dat"
+#define BENCH_FILES		64
+#define BENCH_FILE_SIZE	(256 * 1024)
+#define BENCH_IO		4096
+#define BENCH_APPEND	512
+#define BENCH_OPS		200000		// Per run; meta runs do a quarter of that
+#define BENCH_MAX_THREADS	32
+
+enum { WL_READ, WL_MIXED, WL_META, WL_COUNT };
+static const char *wl_names[] = { "read", "mixed", "meta" };
+
+/**
+ * Worker - One benchmark thread
+ */
+typedef struct{
+	pthread_t tid;
+	int id;
+	int ops;
+	int kind;
+	uint64_t seed;
+	long errors;		// Calls that failed; must stay 0
+}Worker;
+
+static double now_seconds(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint64_t next_rand(uint64_t *s){
+	uint64_t z = (*s += 0x9E3779B97F4A7C15ull);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+	return z ^ (z >> 31);
+}
+
+static void shared_name(char *name, uint64_t r){
+	sprintf(name, "s%d", (int)(r % BENCH_FILES));
+}
+
+/**
+ * shared_io - Reads or overwrites a random chunk of a random shared file
+ */
+static int shared_io(char *buf, uint64_t r, int write){
+
+	char name[MAX_FILE_NAME];
+	shared_name(name, r);
+	int h = fat_open(name);
+	if(h < 0) return -1;
+
+	off_t off = (off_t)((r >> 8) % (BENCH_FILE_SIZE - BENCH_IO));
+	ssize_t n;
+	if(write) n = fat_seek(h, off, SEEK_SET) < 0 ? -1 : fat_write(h, buf, BENCH_IO);
+	else n = fat_pread(h, buf, BENCH_IO, off);
+	fat_close(h);
+	return n == BENCH_IO ? 0 : -1;
+}
+
+static int append_own(const Worker *w, const char *buf){
+
+	char name[MAX_FILE_NAME];
+	sprintf(name, "t%d", w->id);
+	int h = fat_open(name);
+	if(h < 0) return -1;
+	ssize_t n = fat_seek(h, 0, SEEK_END) < 0 ? -1 : fat_write(h, buf, BENCH_APPEND);
+	fat_close(h);
+	return n == BENCH_APPEND ? 0 : -1;
+}
+
+static int meta_cycle(const Worker *w, int k, const char *buf){
+
+	char name[MAX_FILE_NAME];
+	FatStat st;
+	sprintf(name, "m%d_%d", w->id, k);
+	if(fat_create(name) != FAT_OK) return -1;
+	int h = fat_open(name);
+	if(h < 0) return -1;
+	ssize_t n = fat_write(h, buf, BENCH_IO);
+	fat_close(h);
+	if(n != BENCH_IO || fat_stat(name, &st) != FAT_OK || st.size != BENCH_IO) return -1;
+	return fat_delete(name) == FAT_OK ? 0 : -1;
+}
+
+static void *worker_main(void *arg){
+
+	Worker *w = arg;
+	char buf[BENCH_IO];
+	memset(buf, 'a' + w->id % 26, sizeof(buf));
+
+	for(int k = 0; k < w->ops; k++){
+		uint64_t r = next_rand(&w->seed);
+		int pct = (int)(r % 100);
+		int err;
+		r /= 100;
+		if(w->kind == WL_READ) err = shared_io(buf, r, 0);
+		else if(w->kind == WL_META) err = meta_cycle(w, k, buf);
+		else if(pct < 70) err = shared_io(buf, r, 0);
+		else if(pct < 90) err = shared_io(buf, r, 1);
+		else err = append_own(w, buf);
+		if(err != 0) w->errors++;
+	}
+	return NULL;
+}
+
+/**
+ * run_workload - Runs @kind on @threads threads
+ * Returns operations per second, or -1 if a thread could not be started.
+ */
+static double run_workload(int kind, int threads, long *errors){
+
+	static Worker w[BENCH_MAX_THREADS];
+	int total = kind == WL_META ? BENCH_OPS / 4 : BENCH_OPS;
+
+	double t0 = now_seconds();
+	int started;
+	for(started = 0; started < threads; started++){
+		w[started].id = started;
+		w[started].ops = total / threads + (started < total % threads);
+		w[started].kind = kind;
+		w[started].seed = 0x5EEDull * (started + 1) + kind;
+		w[started].errors = 0;
+		if(pthread_create(&w[started].tid, NULL, worker_main, &w[started]) != 0) break;
+	}
+	for(int t = 0; t < started; t++){
+		pthread_join(w[t].tid, NULL);
+		*errors += w[t].errors;
+	}
+	double secs = now_seconds() - t0;
+
+	// Commit, then commit the frees the first commit released
+	fat_sync();
+	fat_sync();
+	return started < threads ? -1 : total / secs;
+}
+
+/**
+ * populate - Creates the shared files and one file per thread
+ */
+static int populate(int max_threads){
+
+	char name[MAX_FILE_NAME];
+	char *buf = (char*)malloc(BENCH_FILE_SIZE);
+	if(buf == NULL) return -1;
+	memset(buf, 's', BENCH_FILE_SIZE);
+
+	int err = 0;
+	for(uint64_t f = 0; f < BENCH_FILES && !err; f++){
+		shared_name(name, f);
+		int h = -1;
+		err = fat_create(name) != FAT_OK || (h = fat_open(name)) < 0 ||
+		      fat_write(h, buf, BENCH_FILE_SIZE) != BENCH_FILE_SIZE;
+		if(h >= 0) fat_close(h);
+	}
+	for(int t = 0; t < max_threads && !err; t++){
+		sprintf(name, "t%d", t);
+		err = fat_create(name) != FAT_OK;
+	}
+	free(buf);
+	return err ? -1 : fat_sync();
+}
+
+/**
+ * run_bench - Runs every workload with 1, 2, 4 ... @max_threads threads
+ */
+int run_bench(int max_threads){
+
+	if(max_threads < 1 || max_threads > BENCH_MAX_THREADS){
+		printf("Usage : bench [threads], threads: 1 .. %d\n", BENCH_MAX_THREADS);
+		return -1;
+	}
+
+	FatGeometry g = { 4096, 131072, 4096 };		// 512 MB, sparse
+	if(fat_mkfs(BENCH_IMAGE, &g) != FAT_OK || fat_mount(BENCH_IMAGE) != FAT_OK){
+		printf("Error : can't create %s.\n", BENCH_IMAGE);
+		return -1;
+	}
+	if(populate(max_threads) != 0){
+		printf("Error : can't populate %s.\n", BENCH_IMAGE);
+		fat_unmount();
+		return -1;
+	}
+
+	printf("FAT stress benchmark: %d files of %d KB, %d ops per run (meta: %d), %ld CPUs\n",
+	       BENCH_FILES, BENCH_FILE_SIZE / 1024, BENCH_OPS, BENCH_OPS / 4, sysconf(_SC_NPROCESSORS_ONLN));
+	printf("%7s", "threads");
+	for(int k = 0; k < WL_COUNT; k++) printf(" %10s/s %6s", wl_names[k], "x");
+	printf("\n");
+
+	double base[WL_COUNT];
+	long errors = 0;
+	for(int t = 1; ; t = t * 2 < max_threads ? t * 2 : max_threads){
+		printf("%7d", t);
+		for(int k = 0; k < WL_COUNT; k++){
+			double rate = run_workload(k, t, &errors);
+			if(t == 1) base[k] = rate;
+			printf(" %12.0f %6.2f", rate, rate / base[k]);
+			fflush(stdout);
+		}
+		printf("\n");
+		if(t == max_threads) break;
+	}
+	if(errors > 0) printf("Warning : %ld operations failed.\n", errors);
+
+	FatCacheStats cs;
+	fat_cache_stats(&cs);
+	uint64_t asked = cs.hits + cs.misses;
+	printf("Block cache: %u blocks, %.1f%% hits, %llu evictions\n", cs.frames,
+	       asked ? 100.0 * cs.hits / asked : 0.0, (unsigned long long)cs.evictions);
+
+	int err = fat_unmount();
+	unlink(BENCH_IMAGE);
+	unlink(BENCH_IMAGE ".journal");
+	return err == FAT_OK && errors == 0 ? 0 : -1;
+}
@@ -1,253 +1,124 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-
-/* Configuration Constants */
-#define MAX_FILE_NUM	100		// Maximum number of files in the directory
-#define NUM_BLOCKS	1024		// Total number of blocks in the data area
-#define BLOCK_SIZE	32			// Size of each block in bytes
-#define MAX_FILE_NAME	100		// Maximum length of a filename
-#define FS_STAT	"fs_state.dat"	// Persistent storage file for FS state
-
-/**
- * FileEntry - Metadata for a single file
- */
-typedef struct{
-	char filename[MAX_FILE_NAME];
-	int  start_block;				// First block index in the FAT chain
-	int  size;						// Current file size in bytes
-}FileEntry;
-
-/**
- * FileSystem - Entire file system structure
+#include <errno.h>
+#include <signal.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "fat.h"
+
+/*
+ * fat.c
+ *
+ * Command line front end of the FAT library (fatfs.c).
+ *   ./fat <command> [args]   runs one command against fs_state.dat
+ *   ./fat mkfs [block_size [blocks [files]]]
+ *                            creates an empty fs_state.dat
+ *   ./fat serve [socket [cache_mb]]
+ *                            keeps the image mounted and runs one command
+ *                            per line from stdin ("-"), or from each client
+ *                            of a UNIX socket in turn
+ *   ./fat bench [threads]    multi-threaded stress benchmark (bench.c)
  */
-typedef struct{
-	int fat_table[NUM_BLOCKS];	// FAT: 0 = Free, 0xFFFF = EOF, Else = Next Block
-	FileEntry directory[MAX_FILE_NUM];
-	char data_area[NUM_BLOCKS * BLOCK_SIZE];  // Physical storage area
-}FileSystem;
 
-FileSystem myfat;	// Global instance of the file system
+#define SERVE_LINE	65536	// Longest command line the server accepts
+#define SERVE_BACKLOG	8
 
 /* ==================================================================
  			CONTROL API
 ===================================================================== */
-int create_file(const char *filename);		
-int write_file(const char *filename, const char* data);  
-int read_file(const char *filename); 			
-int delete_file(const char *name);			
-void list_files(void);					
-int find_free_block(void);				
+int create_file(const char *filename);
+int write_file(const char *filename, const char* data);
+int read_file(const char *filename);
+int delete_file(const char *name);
+void list_files(void);
 
 /* END OF API*/
-void save_file_system(void);		// Save the File System to Disk
-void load_file_system(void);		// Restore the File System from Disk
 
-/**
- * find_free_block - Scans the FAT table for an unallocated block
- * Returns block index if found, or -1 if the disk is full.
- */
-int find_free_block(void){
-
-	for(int i=0; i<NUM_BLOCKS; i++){
-		if(myfat.fat_table[i] == 0) // 0 == free
-			return i;
-	}
-	return -1; // no free block
-}
-
-/**
- * save_file_system - Flushes the in-memory FS structure to a binary file
- */
-void save_file_system(void){
-
-	FILE*f = fopen(FS_STAT,"wb");
-	if(f== NULL){
-		printf("Error : can't save file system state.\n");
-		return;
-	}
-	fwrite(&myfat,sizeof(FileSystem),1,f);
-	fclose(f);
-}
-
-/**
- * load_file_system - Loads the FS state from disk or initializes a new one
- */
-void load_file_system(void){
-
-	FILE*f = fopen(FS_STAT,"rb");
-	if(f== NULL){
-		printf("Warning : No saved state found. Starting fresh.\n");
-		memset(&myfat,0,sizeof(FileSystem));
-		return;
-	}
-	fread(&myfat,sizeof(FileSystem),1,f);
-	fclose(f);
-}
+static volatile sig_atomic_t stop_serving;
 
 /**
  * create_file - Registers a new file in the directory
- * 1. Checks for duplicate filenames.
- * 2. Finds an empty directory entry and an initial free block.
  */
 int create_file(const char* filename){
 
-	// Check for duplicate filename
-	for(int i = 0; i< MAX_FILE_NUM; i++){
-		if(strcmp(myfat.directory[i].filename,filename)==0){
-			printf("File '%s' already exists.\n",filename);
-			return -1;
-		}
-	}
-
-	// Find empty directory entry
-	for(int i = 0; i< MAX_FILE_NUM; i++){
-		if(myfat.directory[i].filename[0]=='\0'){
-			
-			for(int j = 0; j< NUM_BLOCKS; j++){
-				if(myfat.fat_table[j]==0){
-					myfat.fat_table[j] = 0XFFFF;;
-
-					strcpy(myfat.directory[i].filename,filename);
-					myfat.directory[i].start_block = j;
-					myfat.directory[i].size = 0;
-					printf("File '%s' created.\n",filename);
-					return 0;
-				}
-			}
-		}
+	int err = fat_create(filename);
+	if(err == FAT_EINVAL) printf("Error: Invalid filename.\n");
+	else if(err == FAT_EEXIST) printf("File '%s' already exists.\n",filename);
+	else if(err != FAT_OK) printf("Error: Directory or Disk full.\n");
+	else{
+		printf("File '%s' created.\n",filename);
+		return 0;
 	}
-	printf("Error: Directory or Disk full.\n");
 	return -1;
 }
 
-
 /**
  * write_file - Appends data to an existing file
- * Handles block allocation and FAT chain linking if additional space is needed.
  */
 int write_file(const char *filename,const char *data){
 
-	for(int i = 0; i< MAX_FILE_NUM; i++){
-	    if(strcmp(myfat.directory[i].filename,filename) == 0){
-
-	    int start_block = myfat.directory[i].start_block;
-            int file_size   = myfat.directory[i].size;  
-            int data_len    = strlen(data);  
-
-            if (start_block < 0 || start_block >= NUM_BLOCKS) {
-                printf("File %s has invalid start block.\n", filename);
-                return -1;
-            }
-
-			// Traverse to the last block of the file
-            int block = start_block;
-            int remain = file_size;
-
-            while (remain >= BLOCK_SIZE && myfat.fat_table[block] != 0xFFFF) {
-                remain -= BLOCK_SIZE;
-                block = myfat.fat_table[block];				// 다음 블록으로 이동
-            }
-
-            int offset_in_block = file_size % BLOCK_SIZE;	// 마지막 블록 안에서 이미 사용 중인 바이트 수
-
-            // block, offset_in_block 위치부터 data를 이어서 쓰기 시작
-            int bytes_written = 0;
-            int data_offset   = 0;
-		
-            while (bytes_written < data_len) {
-                if (block < 0 || block >= NUM_BLOCKS) {
-                    printf("FAT chain corrupt file %s.\n", filename);
-                    return -1;
-                }
-				// Allocate a new block if the current one is full
-                int space_in_block = BLOCK_SIZE - offset_in_block;
-                if (space_in_block <= 0) {
-                    // 이 블록 꽉 찼으면 다음 free 블록을 FAT에서 가져와 체인에 연결
-                    int new_block = find_free_block();
-                    if (new_block < 0) {
-                        printf("No more space in FAT table. Partial data append to %s.\n", filename);
-                        break; 
-                    }
-                    myfat.fat_table[block] = new_block;
-                    myfat.fat_table[new_block] = 0xFFFF;
-                    block = new_block;
-                    offset_in_block = 0;
-                    space_in_block = BLOCK_SIZE;
-                }
-
-				// 데이터 중 아직 안쓴 부분의 길이 정의
-				int remaining_data = data_len - bytes_written;
-				// 이번 루프에서 현재 블록에 얼마나 쓸지 결정
-                int to_write = (remaining_data < space_in_block) ? remaining_data : space_in_block;
-
-				// 나머지 데이터 쓰기
-                memcpy(&myfat.data_area[block * BLOCK_SIZE + offset_in_block],
-                       &data[data_offset], to_write);
-
-                bytes_written    += to_write; // 전체에서 지금까지 쓴 양 누적 
-                data_offset      += to_write; // 원본 데이터에서 다음에 쓸 위치 갱신
-                offset_in_block  += to_write; // 현재 블록에서 다음에 쓸 위치 갱신
-            }
-
-			// 파일 크기 갱신 ( 기존 크기 + 새로 쓴 바이트 수 )
-            myfat.directory[i].size = file_size + bytes_written;
-            printf("Data written to '%s'.\n", filename);
-            return 0;
-		}	
+	int h = fat_open(filename);
+	if(h == FAT_ENOENT){
+		printf("FILE %s not found.\n",filename);
+		return -1;
+	}
+	if(h < 0){
+		printf("Error: Too many open files.\n");
+		return -1;
 	}
-	printf("FILE %s not found.\n",filename);
-	return -1;
-}
 
+	ssize_t len = strlen(data);
+	fat_seek(h, 0, SEEK_END);
+	ssize_t n = fat_write(h, data, len);
+	fat_close(h);
+
+	if(n == FAT_ECORRUPT){
+		printf("FAT chain corrupt file %s.\n", filename);
+		return -1;
+	}
+	if(n < len) printf("No more space in FAT table. Partial data append to %s.\n", filename);
+	printf("Data written to '%s'.\n", filename);
+	return 0;
+}
 
 /**
- * read_file - Reads and prints file content by following the FAT chain
+ * read_file - Prints file content, handed from the image to stdout directly
  */
 int read_file(const char* filename){
 
-	for(int i = 0; i< MAX_FILE_NUM; i++){
-		if(strcmp(myfat.directory[i].filename,filename) == 0){
-			int start_block = myfat.directory[i].start_block;
-            int total_size = myfat.directory[i].size;
-
-			// 파일이 비었는지 체크 
-			if(total_size == 0){
-				printf("file %s is empty\n",filename);
-				return 0;
-			}
-
-			// FILE not Initalized  
-			if(start_block == -1){            
-				printf("File %s not initalized. Use create command first.\n",filename);           
-				return -1;   
-			}
-			
-			printf("Content of '%s' : ",filename);
-
-			int block = start_block;
-			int bytes_read = 0;
-			while(block != 0xFFFF && bytes_read < total_size){
-				if(block < 0 || block >= NUM_BLOCKS) {
-					printf("FAT chain corrupt while read %s.\n",filename);
-					return -1;
-				}
-		
-				int remaining_bytes_in_block = total_size - bytes_read;              
-				int read_size = (remaining_bytes_in_block < BLOCK_SIZE) ? remaining_bytes_in_block : BLOCK_SIZE;
-
-				printf("%.*s",read_size,&myfat.data_area[block * BLOCK_SIZE]);
-				bytes_read +=read_size;
-				int next = myfat.fat_table[block];
-				block = next;
-			}
-			printf("\n");
-			return 0;
-		}
+	FatStat st;
+	if(fat_stat(filename, &st) != FAT_OK){
+		printf("File %s not found.\n",filename);
+		return -1;
 	}
 
-	printf("File %s not found.\n",filename);
-	return -1;
+	// 파일이 비었는지 체크
+	if(st.size == 0){
+		printf("file %s is empty\n",filename);
+		return 0;
+	}
+
+	int h = fat_open(filename);
+	if(h < 0){
+		printf("Error: Too many open files.\n");
+		return -1;
+	}
+	printf("Content of '%s' : ",filename);
+	fflush(stdout);
+	ssize_t n = fat_sendfile(STDOUT_FILENO, h, st.size);
+	fat_close(h);
+	if(n == FAT_ECORRUPT){
+		printf("FAT chain corrupt while read %s.\n",filename);
+		return -1;
+	}
+	printf("\n");
+	return 0;
 }
 
 /**
@@ -255,39 +126,25 @@ int read_file(const char* filename){
  */
 int delete_file(const char * filename){
 
-	for(int i = 0; i< MAX_FILE_NUM;i++){
-		if(strcmp(myfat.directory[i].filename,filename) == 0){
-			int start_block = myfat.directory[i].start_block;
-			int block = start_block;
-
-			// Release all linked blocks in FAT
-			while(block != 0xFFFF){
-				int next_block  = myfat.fat_table[block];
-				myfat.fat_table[block] = 0 ; // Mark as free
-				block = next_block;
-			}
-				
-			myfat.directory[i].filename[0] = '\0';	// Invalidate directory entry
-			printf("File '%s' deleted.\n",filename);
-			return 0;
-		}
-	
+	int err = fat_delete(filename);
+	if(err == FAT_OK){
+		printf("File '%s' deleted.\n",filename);
+		return 0;
 	}
-	printf("File %s not found.\n",filename);
+	if(err == FAT_EBUSY) printf("File %s is open.\n",filename);
+	else printf("File %s not found.\n",filename);
 	return -1;
 }
 
-
 /**
  * list_files - Lists all existing files and their sizes
  */
 void list_files(){
 	printf("Files in the file system.\n");
-	for(int i = 0; i < MAX_FILE_NUM; i++){
-		if(myfat.directory[i].filename[0] != '\0'){
-			printf("File : %s, SIze: %d bytes\n",
-				myfat.directory[i].filename,myfat.directory[i].size);
-		}
+	FatStat st;
+	int pos = 0;
+	while(fat_readdir(&pos, &st) > 0){
+		printf("File : %s, SIze: %ld bytes\n", st.name, st.size);
 	}
 }
 
@@ -316,15 +173,219 @@ void execute_cmd(char *cmd, char *filename, char* data, int num){
 	else printf("Invalid command.\n");
 }
 
+/**
+ * run_line - Splits one server line like a command line and runs it
+ * Everything after the filename is the data, spaces included.
+ * "sync" forces the pending changes to disk, "stats" prints the block
+ * cache counters.
+ */
+static void run_line(char *line){
+
+	size_t n = strlen(line);
+	if(n > 0 && line[n - 1] == '\r') line[n - 1] = '\0';
+
+	char *cmd = line + strspn(line, " ");
+	if(*cmd == '\0') return;
+	char *filename = NULL, *data = NULL;
+	char *sp = strchr(cmd, ' ');
+	if(sp != NULL){
+		*sp = '\0';
+		filename = sp + 1 + strspn(sp + 1, " ");
+		sp = strchr(filename, ' ');
+		if(sp != NULL){
+			*sp = '\0';
+			data = sp + 1;
+		}
+		if(*filename == '\0') filename = NULL;
+	}
+
+	if(strcmp(cmd, "sync") == 0){
+		fflush(stdout);
+		if(fat_sync() == FAT_OK) printf("Synced.\n");
+		else printf("Error : can't save file system state.\n");
+		return;
+	}
+	if(strcmp(cmd, "stats") == 0){
+		FatCacheStats cs;
+		fat_cache_stats(&cs);
+		uint64_t asked = cs.hits + cs.misses;
+		printf("Cache : %u blocks, %u dirty, hits %llu, misses %llu (%.1f%% hits)\n", cs.frames, cs.dirty,
+		       (unsigned long long)cs.hits, (unsigned long long)cs.misses, asked ? 100.0 * cs.hits / asked : 0.0);
+		printf("        read ahead %llu (%llu used), evictions %llu, write-backs %llu\n",
+		       (unsigned long long)cs.prefetched, (unsigned long long)cs.prefetch_hits,
+		       (unsigned long long)cs.evictions, (unsigned long long)cs.writebacks);
+		return;
+	}
+	execute_cmd(cmd, filename, data, 2 + (filename != NULL) + (data != NULL));
+}
+
+/**
+ * serve_stream - Runs the commands read from @in until end of input
+ * Output goes to stdout. Persistence is coalesced: the image is synced
+ * only when no more input is waiting, so a burst of commands costs one
+ * journal commit instead of one per command.
+ */
+static void serve_stream(int in){
+
+	static char buf[SERVE_LINE + 1];
+	size_t have = 0;
+	int skipping = 0;	// Dropping the rest of an overlong line
+
+	while(!stop_serving){
+		struct pollfd p = { in, POLLIN, 0 };
+		if(poll(&p, 1, 0) == 0){
+			fflush(stdout);
+			fat_sync();
+		}
+		ssize_t r = read(in, buf + have, SERVE_LINE - have);
+		if(r < 0 && errno == EINTR) continue;
+		if(r <= 0) break;
+		have += r;
+
+		size_t start = 0;
+		char *nl;
+		while((nl = memchr(buf + start, '\n', have - start)) != NULL){
+			*nl = '\0';
+			if(!skipping) run_line(buf + start);
+			skipping = 0;
+			start = nl - buf + 1;
+		}
+		memmove(buf, buf + start, have - start);
+		have -= start;
+		if(have == SERVE_LINE){
+			printf("Error: Command line too long.\n");
+			skipping = 1;
+			have = 0;
+		}
+	}
+	if(have > 0 && !skipping){	// Last line without a newline
+		buf[have] = '\0';
+		run_line(buf);
+	}
+	fflush(stdout);
+	fat_sync();
+}
+
+static void on_stop(int sig){
+	(void)sig;
+	stop_serving = 1;
+}
+
+/**
+ * serve_socket - Accepts clients on a UNIX socket at @path, one at a time
+ * Each client's replies go back over its own connection.
+ */
+static int serve_socket(const char *path){
+
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if(strlen(path) >= sizeof(addr.sun_path)){
+		printf("Error : socket path too long.\n");
+		return -1;
+	}
+	strcpy(addr.sun_path, path);
+
+	int s = socket(AF_UNIX, SOCK_STREAM, 0);
+	unlink(path);
+	if(s < 0 || bind(s, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(s, SERVE_BACKLOG) != 0){
+		printf("Error : can't listen on %s.\n", path);
+		if(s >= 0) close(s);
+		return -1;
+	}
+
+	fflush(stdout);
+	int saved = dup(STDOUT_FILENO);
+	while(!stop_serving){
+		int c = accept(s, NULL, NULL);
+		if(c < 0){
+			if(errno == EINTR) continue;
+			break;
+		}
+		dup2(c, STDOUT_FILENO);
+		serve_stream(c);
+		dup2(saved, STDOUT_FILENO);
+		close(c);
+	}
+	close(saved);
+	close(s);
+	unlink(path);
+	return 0;
+}
+
+/**
+ * serve - Long-running mode on stdin, or on a UNIX socket if @path is given
+ * SIGINT / SIGTERM stop it after the current command, with a final sync.
+ */
+static void serve(const char *path){
+
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = on_stop;		// No SA_RESTART: a blocked read / accept returns
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+	signal(SIGPIPE, SIG_IGN);		// A client going away is not fatal
+
+	if(path == NULL) serve_stream(STDIN_FILENO);
+	else serve_socket(path);
+}
+
+/**
+ * make_fs - Formats fs_state.dat with the geometry given on the command line
+ */
+static int make_fs(int argc, char *argv[]){
+
+	FatGeometry g = { FAT_DEFAULT_BLOCK_SIZE, FAT_DEFAULT_BLOCKS, FAT_DEFAULT_FILES };
+	if(argc > 2) g.block_size = (uint32_t)strtoul(argv[2], NULL, 0);
+	if(argc > 3) g.num_blocks = (uint32_t)strtoul(argv[3], NULL, 0);
+	if(argc > 4) g.max_files  = (uint32_t)strtoul(argv[4], NULL, 0);
+
+	int err = fat_mkfs(FS_STAT, &g);
+	if(err == FAT_EINVAL){
+		printf("Usage : mkfs [block_size [blocks [files]]]\n");
+		printf("        block_size: power of two, %d .. %d (default %d)\n",
+		       FAT_MIN_BLOCK, FAT_MAX_BLOCK, FAT_DEFAULT_BLOCK_SIZE);
+		printf("        blocks: 2 .. %u (default %d), files: 1 .. %u (default %d)\n",
+		       FAT_MAX_CLUSTERS, FAT_DEFAULT_BLOCKS, FAT_MAX_FILES, FAT_DEFAULT_FILES);
+		return -1;
+	}
+	if(err != FAT_OK){
+		printf("Error : can't create file system image.\n");
+		return -1;
+	}
+	printf("File system created: %u blocks of %u bytes, %u files.\n", g.num_blocks, g.block_size, g.max_files);
+	return 0;
+}
+
 int main(int argc, char* argv[])
 {
 	if(argc <=1){
 		printf("USAGE : ./fat <COMMAND> [ARGS]...\n");
+		printf("        ./fat mkfs [BLOCK_SIZE [BLOCKS [FILES]]]\n");
+		printf("        ./fat serve [SOCKET|- [CACHE_MB]]\n");
+		printf("        ./fat bench [THREADS]\n");
+		printf("A missing %s is created with %d blocks of %d bytes and %d files;\n",
+		       FS_STAT, FAT_FRESH_BLOCKS, FAT_FRESH_BLOCK_SIZE, FAT_FRESH_FILES);
+		printf("mkfs makes a larger one (default %d blocks of %d bytes, %d files).\n",
+		       FAT_DEFAULT_BLOCKS, FAT_DEFAULT_BLOCK_SIZE, FAT_DEFAULT_FILES);
 		exit(1);
 	}
+	if(strcmp(argv[1],"mkfs") == 0) exit(make_fs(argc, argv) == 0 ? 0 : 1);
+	if(strcmp(argv[1],"bench") == 0) exit(run_bench(argc > 2 ? atoi(argv[2]) : 32) == 0 ? 0 : 1);
+	if(strcmp(argv[1],"serve") == 0 && argc > 3) fat_set_cache((size_t)strtoul(argv[3], NULL, 0) << 20);
 
-	load_file_system();				
-	execute_cmd(argv[1],argv[2],argv[3],argc); 	
-	save_file_system();
+	int err = fat_mount(FS_STAT);
+	if(err == FAT_EINVAL){
+		printf("Error : %s is not a valid file system image.\n", FS_STAT);
+		exit(1);
+	}
+	if(err != FAT_OK){
+		printf("Error : can't open file system image.\n");
+		exit(1);
+	}
+
+	if(strcmp(argv[1],"serve") == 0) serve(argc > 2 && strcmp(argv[2], "-") != 0 ? argv[2] : NULL);
+	else execute_cmd(argv[1],argv[2],argv[3],argc);
+	if(fat_unmount() != FAT_OK) printf("Error : can't save file system state.\n");
 	exit(0);
-}
\ No newline at end of file
+}
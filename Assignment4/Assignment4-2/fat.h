@@ -0,0 +1,116 @@
+#ifndef FAT_H
+#define FAT_H
+/*
+ * fat.h
+ *
+ * FAT file system library
+ *
+ * This file declares:
+ *  - creating, mounting, syncing and unmounting an image
+ *  - the file operations on names (create, delete, stat, directory walk)
+ *  - the handle operations (open, read, write, seek, close, pread)
+ *  - sizing the block cache that file data goes through, and its counters
+ * Every call returns a negative FAT_E* code on failure.
+ *
+ * Source files using this header:
+ *  - fatfs.c   (the library)
+ *  - bcache.c  (block cache of the library)
+ *  - fat.c     (command line and server front end)
+ *  - bench.c   (multi-threaded stress benchmark)
+ *
+ * Every call may be made from several threads at once, except fat_mkfs,
+ * fat_mount and fat_unmount. A handle is used by one thread at a time.
+ */
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#define MAX_FILE_NAME	100		// Maximum length of a filename
+#define FS_STAT	"fs_state.dat"	// Persistent storage file for FS state (journal: FS_STAT ".journal")
+#define FAT_MAX_OPEN	64		// Open handles at once
+
+/* Geometry limits and the defaults of fat_mkfs */
+#define FAT_MIN_BLOCK		512
+#define FAT_MAX_BLOCK		65536
+#define FAT_MAX_CLUSTERS	(1u << 28)
+#define FAT_MAX_FILES		(1u << 24)
+#define FAT_DEFAULT_BLOCK_SIZE	4096
+#define FAT_DEFAULT_BLOCKS		16384	// 64 MB
+#define FAT_DEFAULT_FILES		65536
+
+/* Small image fat_mount creates when there is none (512 KB, 100 files) */
+#define FAT_FRESH_BLOCK_SIZE	512
+#define FAT_FRESH_BLOCKS		1024
+#define FAT_FRESH_FILES			100
+#define FAT_DEFAULT_CACHE		(64u << 20)	// Block cache bytes
+
+/* Error codes */
+#define FAT_OK			0
+#define FAT_ENOENT		-1		// No such file
+#define FAT_EEXIST		-2		// File already exists
+#define FAT_ENOSPC		-3		// Directory or disk full
+#define FAT_EINVAL		-4		// Bad name, offset or image
+#define FAT_ECORRUPT	-5		// Broken FAT chain
+#define FAT_EBADF		-6		// Not an open handle
+#define FAT_EBUSY		-7		// File is open
+#define FAT_EIO			-8		// Image could not be read or written
+
+/**
+ * FatStat - What fat_stat / fat_readdir report about a file
+ */
+typedef struct{
+	char name[MAX_FILE_NAME];
+	long size;
+}FatStat;
+
+/**
+ * FatGeometry - Shape of an image, fixed by fat_mkfs
+ * block_size is a power of two in [FAT_MIN_BLOCK, FAT_MAX_BLOCK].
+ */
+typedef struct{
+	uint32_t block_size;
+	uint32_t num_blocks;	// 2 .. FAT_MAX_CLUSTERS, block 0 is reserved
+	uint32_t max_files;		// 1 .. FAT_MAX_FILES
+}FatGeometry;
+
+/**
+ * FatCacheStats - Block cache counters since mount
+ */
+typedef struct{
+	uint64_t hits, misses;		// Blocks asked for
+	uint64_t prefetched;		// Blocks read ahead
+	uint64_t prefetch_hits;		// ... and used afterwards
+	uint64_t evictions;
+	uint64_t writebacks;		// Dirty blocks written to the image
+	uint32_t frames;			// Cache size in blocks
+	uint32_t dirty;				// Blocks waiting for write-back
+}FatCacheStats;
+
+/* Image */
+int fat_mkfs(const char *path, const FatGeometry *g);	// NULL g: the defaults
+int fat_mount(const char *path);	// Maps the image, creating a small one if missing
+int fat_sync(void);					// Commits everything changed since the last sync
+int fat_unmount(void);				// Syncs, checkpoints the journal and unmaps
+int fat_geometry(FatGeometry *g);	// Of the mounted image
+int fat_set_cache(size_t bytes);	// Block cache size for the next mount, 0: the default
+int fat_cache_stats(FatCacheStats *st);
+
+/* Names */
+int fat_create(const char *name);
+int fat_delete(const char *name);
+int fat_stat(const char *name, FatStat *st);
+int fat_readdir(int *pos, FatStat *st);	// 1 per file from *pos = 0 on, then 0
+
+/* Handles */
+int fat_open(const char *name);
+int fat_close(int h);
+long fat_seek(int h, long off, int whence);	// SEEK_SET / SEEK_CUR / SEEK_END, within [0, size]
+ssize_t fat_read(int h, void *buf, size_t len);
+ssize_t fat_write(int h, const void *buf, size_t len);	// Short count when the disk fills up
+ssize_t fat_pread(int h, void *buf, size_t len, off_t off);
+ssize_t fat_sendfile(int out_fd, int h, size_t len);	// writev()s straight from the image
+
+/* Stress benchmark (bench.c), on a scratch image */
+int run_bench(int max_threads);
+
+#endif
@@ -0,0 +1,1602 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include "fat.h"
+#include "bcache.h"
+
+/*
+ * fatfs.c
+ *
+ * The FAT file system behind fat.h. The geometry (block size, block count,
+ * directory size) is chosen by fat_mkfs and read back from the superblock
+ * at mount time.
+ *
+ * File data goes through the block cache of bcache.c, so the memory used
+ * stays bounded however large the image is; the metadata regions are
+ * mapped. Changes are made durable by fat_sync():
+ *  - Dirty cached blocks are written back first.
+ *  - The metadata regions are mapped MAP_PRIVATE, so the kernel never
+ *    writes them back on its own. Their dirty sectors are appended to a
+ *    write-ahead journal (<image>.journal) as one checksummed transaction
+ *    and made durable with a single fdatasync, however many operations
+ *    went into it (group commit).
+ *  - Journaled sectors are copied to their home location (checkpoint)
+ *    once the journal grows past JOURNAL_CHECKPOINT and at unmount.
+ * Mount replays every complete transaction; a torn tail is ignored.
+ *
+ * Locking, outermost first (the library is safe to call from many threads):
+ *  - fs_lock    read by every operation, written by fat_sync / fat_unmount
+ *  - dir_lock   the directory, its index and the free-slot stack: read by
+ *               lookups, written by create / delete
+ *  - open_lock  the handle table and the file locks
+ *  - FileLock   one rwlock per open file: readers share it, a writer
+ *               owns it, so files are read and written independently
+ *  - AllocGroup the free map is split into ALLOC_GROUPS groups with a lock
+ *               and next-fit cursor each; a file allocates from the group
+ *               of its directory slot first
+ *  - DirtyStripe dirty sector lists, striped by sector
+ */
+
+#define FS_MAGIC	0x31544146u	// "FAT1"
+#define FS_VERSION	4
+#define FS_SECTOR	4096		// Regions are sector aligned; dirty tracking unit
+
+/* FAT entry values; anything else is the next block of the chain */
+#define FAT_FREE	0u
+#define FAT_BAD		0xFFFFFFF7u	// Never allocated (block 0, bad media)
+#define FAT_EOF		0xFFFFFFFFu
+
+#define IOV_BATCH	64			// iovecs handed to one writev (journal records)
+#define CHAIN_STRIDE	64		// Clusters between the chain positions a file remembers
+
+#define JNL_MAGIC	0x4C4E524Au	// "JRNL", transaction header
+#define JNL_COMMIT	0x54494D43u	// "CMIT", transaction trailer
+#define JNL_REC		(sizeof(uint64_t) + FS_SECTOR)	// Sector number + sector image
+#define JOURNAL_CHECKPOINT	(8 << 20)	// Journal bytes that trigger a checkpoint
+
+#define ALLOC_GROUPS	16		// Independently locked parts of the free map
+#define DIRTY_STRIPES	16		// Independently locked dirty lists
+#define DIRTY_RUN		16		// Sectors in a row that go to the same dirty list
+
+#define RA_MIN			4		// First read-ahead window of a sequential reader, in blocks
+#define RA_MAX			32		// Largest window; it doubles on every sequential refill
+
+/**
+ * FileEntry - Metadata for a single file
+ */
+typedef struct{
+	char     filename[MAX_FILE_NAME];
+	uint32_t start_block;			// First block index in the FAT chain
+	uint32_t tail_block;			// Last block of the chain (FAT_EOF: unknown)
+	uint32_t tail_cluster;			// Its index within the file
+	int64_t  size;					// Current file size in bytes
+}FileEntry;
+
+/**
+ * SuperBlock - First sector of the image
+ * Records the geometry and where each region starts, plus the allocator
+ * state.
+ */
+typedef struct{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t num_blocks, block_size, max_files, hash_slots;
+	uint64_t fat_offset, dir_offset, index_offset, map_offset, slots_offset, data_offset;
+	uint64_t image_size;
+	int32_t  reserved;				// Was the next-fit cursor, now per allocation group
+	int32_t  nfree_slots;
+}SuperBlock;
+
+/*
+ * On-disk layout, every region starting on a sector (the data region on a
+ * block if blocks are larger):
+ * superblock | FAT | directory | directory index | free map | free slots | data
+ */
+static char *image;				// Metadata regions, [0, data_offset) (MAP_PRIVATE)
+static SuperBlock *sb;
+static uint32_t *fat_table;		// FAT_FREE, FAT_EOF, FAT_BAD or the next block
+static FileEntry *directory;
+static int32_t *dir_index;		// Filename hash -> directory slot + 1 (0 = empty), linear probing
+static uint64_t *free_map;		// 1 bit per block, set = free
+static int32_t *free_slots;		// Unused directory slots, lowest on top
+
+/* Geometry, copied from the superblock at mount */
+static uint32_t num_blocks, block_size, max_files, hash_slots, map_words;
+
+/**
+ * FileLock - Reader/writer lock of a file, shared by its handles
+ * Chain cache: marks[k] is the block of cluster k * CHAIN_STRIDE, filled in
+ * by every handle as it walks the chain. Links only change at the end of
+ * the chain or when the file is deleted, so the marks outlive the last
+ * close: a reopen finds them as long as the lock has not been taken for
+ * another file. Readers share the file lock, hence chain_lock.
+ */
+typedef struct{
+	int  slot;
+	int  refs;				// Handles open on the file; 0 = unused
+	pthread_rwlock_t lock;
+	pthread_mutex_t chain_lock;
+	uint32_t *marks;
+	uint32_t nmarks, cap;
+}FileLock;
+
+/**
+ * OpenFile - An open handle: directory slot and byte position
+ * cur is the last cluster the handle resolved, the start of its next walk.
+ * A handle is used by one thread at a time; the file lock orders it
+ * against the handles of other threads.
+ * Read-ahead: a read starting at ra_next continues the previous one; blocks
+ * up to cluster ra_end have been requested from the cache already.
+ */
+typedef struct{
+	int  used;
+	int  slot;
+	FileLock *fl;
+	long pos;
+	uint64_t cur_cluster;
+	uint32_t cur_block;
+	uint64_t ra_next, ra_end;
+	uint32_t ra_window;
+}OpenFile;
+
+static OpenFile handles[FAT_MAX_OPEN];
+static FileLock file_locks[FAT_MAX_OPEN];
+
+static pthread_rwlock_t fs_lock = PTHREAD_RWLOCK_INITIALIZER;
+static pthread_rwlock_t dir_lock = PTHREAD_RWLOCK_INITIALIZER;
+static pthread_mutex_t open_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * AllocGroup - A part of the free map with its own lock
+ * Covers the map words [first, end), so no bitmap word is shared.
+ */
+typedef struct{
+	pthread_mutex_t lock;
+	uint32_t first, end;
+	uint32_t cursor;		// Next-fit: search starts after the last allocation
+}AllocGroup;
+
+static AllocGroup groups[ALLOC_GROUPS];
+static uint32_t ngroups;
+
+static int fs_fd = -1;
+static size_t cache_bytes = FAT_DEFAULT_CACHE;
+static int jnl_fd = -1;
+static uint64_t jnl_seq;		// Last transaction written
+static uint64_t jnl_size;		// Bytes in the journal since the last checkpoint
+static uint64_t data_sector;	// First sector of the data region
+
+/**
+ * SectorRange - Sectors [first, last] of the image
+ */
+typedef struct{
+	uint64_t first, last;
+}SectorRange;
+
+/**
+ * RangeList - Sector ranges in the order they were added
+ * Adjacent additions are merged on the fly, the rest by range_merge.
+ */
+typedef struct{
+	SectorRange *r;
+	size_t n, cap;
+}RangeList;
+
+/**
+ * DirtyStripe - Sectors changed since the last sync, for every DIRTY_RUN-th
+ * run of DIRTY_RUN sectors
+ */
+typedef struct{
+	pthread_mutex_t lock;
+	RangeList l;
+}DirtyStripe;
+
+static DirtyStripe dirty[DIRTY_STRIPES];
+static RangeList logged;		// Metadata in the journal, not yet checkpointed
+
+/* Blocks freed since the last sync: not reused until the free is committed (dir_lock) */
+static uint32_t *pending_free;
+static size_t npending, pending_cap;
+
+static uint64_t align_up(uint64_t x, uint64_t a){
+	return (x + a - 1) / a * a;
+}
+
+/**
+ * layout - Places the regions of an image of @blocks blocks of @bsize bytes
+ * and a directory of @files entries
+ * The directory index gets the next power of two at or above twice the
+ * directory size, so its load stays at or below 1/2.
+ */
+static void layout(SuperBlock *s, uint32_t blocks, uint32_t bsize, uint32_t files){
+
+	s->num_blocks = blocks;
+	s->block_size = bsize;
+	s->max_files = files;
+	s->hash_slots = 1;
+	while(s->hash_slots < 2 * files) s->hash_slots *= 2;
+
+	s->fat_offset   = FS_SECTOR;
+	s->dir_offset   = align_up(s->fat_offset + (uint64_t)blocks * sizeof(uint32_t), FS_SECTOR);
+	s->index_offset = align_up(s->dir_offset + (uint64_t)files * sizeof(FileEntry), FS_SECTOR);
+	s->map_offset   = align_up(s->index_offset + (uint64_t)s->hash_slots * sizeof(int32_t), FS_SECTOR);
+	s->slots_offset = align_up(s->map_offset + (uint64_t)(blocks + 63) / 64 * sizeof(uint64_t), FS_SECTOR);
+	s->data_offset  = align_up(s->slots_offset + (uint64_t)files * sizeof(int32_t),
+	                           bsize > FS_SECTOR ? bsize : FS_SECTOR);
+	s->image_size   = s->data_offset + (uint64_t)blocks * bsize;
+}
+
+static int valid_geometry(uint32_t blocks, uint32_t bsize, uint32_t files){
+	return bsize >= FAT_MIN_BLOCK && bsize <= FAT_MAX_BLOCK && (bsize & (bsize - 1)) == 0 &&
+	       blocks >= 2 && blocks <= FAT_MAX_CLUSTERS && files >= 1 && files <= FAT_MAX_FILES;
+}
+
+/**
+ * map_image - Maps the metadata of the image described by @head and points the regions into it
+ */
+static int map_image(const SuperBlock *head){
+
+	void *m = mmap(NULL, head->data_offset, PROT_READ | PROT_WRITE, MAP_PRIVATE, fs_fd, 0);
+	if(m == MAP_FAILED) return FAT_EIO;
+
+	image = m;
+	sb = (SuperBlock*)image;
+	fat_table  = (uint32_t*)(image + sb->fat_offset);
+	directory  = (FileEntry*)(image + sb->dir_offset);
+	dir_index  = (int32_t*)(image + sb->index_offset);
+	free_map   = (uint64_t*)(image + sb->map_offset);
+	free_slots = (int32_t*)(image + sb->slots_offset);
+
+	num_blocks = sb->num_blocks;
+	block_size = sb->block_size;
+	max_files  = sb->max_files;
+	hash_slots = sb->hash_slots;
+	map_words  = (num_blocks + 63) / 64;
+	data_sector = sb->data_offset / FS_SECTOR;
+
+	ngroups = map_words < ALLOC_GROUPS ? map_words : ALLOC_GROUPS;
+	for(uint32_t g = 0; g < ngroups; g++){
+		pthread_mutex_init(&groups[g].lock, NULL);
+		groups[g].first = (uint64_t)map_words * g / ngroups;
+		groups[g].end = (uint64_t)map_words * (g + 1) / ngroups;
+		groups[g].cursor = groups[g].first * 64;
+	}
+	for(int k = 0; k < DIRTY_STRIPES; k++){
+		pthread_mutex_init(&dirty[k].lock, NULL);
+		dirty[k].l.n = 0;
+	}
+	logged.n = 0;
+	npending = 0;
+	return FAT_OK;
+}
+
+static void unmap_image(void){
+	for(uint32_t g = 0; g < ngroups; g++) pthread_mutex_destroy(&groups[g].lock);
+	for(int k = 0; k < DIRTY_STRIPES; k++) pthread_mutex_destroy(&dirty[k].lock);
+	munmap(image, data_sector * FS_SECTOR);
+	close(fs_fd);
+	fs_fd = -1;
+}
+
+static void range_add(RangeList *l, uint64_t first, uint64_t last){
+
+	if(l->n > 0){
+		SectorRange *r = &l->r[l->n - 1];
+		if(first <= r->last + 1 && last + 1 >= r->first){
+			if(first < r->first) r->first = first;
+			if(last > r->last) r->last = last;
+			return;
+		}
+	}
+	if(l->n == l->cap){
+		l->cap = l->cap ? l->cap * 2 : 256;
+		l->r = (SectorRange*)realloc(l->r, sizeof(SectorRange) * l->cap);
+	}
+	l->r[l->n].first = first;
+	l->r[l->n].last = last;
+	l->n++;
+}
+
+static int cmp_range(const void *a, const void *b){
+	const SectorRange *x = a, *y = b;
+	return (x->first > y->first) - (x->first < y->first);
+}
+
+/**
+ * range_merge - Sorts @l and merges overlapping or adjacent ranges
+ */
+static void range_merge(RangeList *l){
+
+	if(l->n < 2) return;
+	qsort(l->r, l->n, sizeof(SectorRange), cmp_range);
+	size_t out = 0;
+	for(size_t k = 1; k < l->n; k++){
+		if(l->r[k].first <= l->r[out].last + 1){
+			if(l->r[k].last > l->r[out].last) l->r[out].last = l->r[k].last;
+		}
+		else l->r[++out] = l->r[k];
+	}
+	l->n = out + 1;
+}
+
+/**
+ * mark_dirty - Records that [p, p + len) of the metadata changed
+ */
+static void mark_dirty(const void *p, size_t len){
+
+	uint64_t off = (uint64_t)((const char*)p - image);
+	uint64_t first = off / FS_SECTOR;
+	DirtyStripe *d = &dirty[first / DIRTY_RUN % DIRTY_STRIPES];
+	pthread_mutex_lock(&d->lock);
+	range_add(&d->l, first, (off + len - 1) / FS_SECTOR);
+	pthread_mutex_unlock(&d->lock);
+}
+
+/**
+ * collect_dirty - Moves every dirty range into @out, sorted and merged
+ * Only called with the image to itself (fs_lock written, or mkfs).
+ */
+static void collect_dirty(RangeList *out){
+
+	for(int k = 0; k < DIRTY_STRIPES; k++){
+		for(size_t i = 0; i < dirty[k].l.n; i++) range_add(out, dirty[k].l.r[i].first, dirty[k].l.r[i].last);
+		dirty[k].l.n = 0;
+	}
+	range_merge(out);
+}
+
+static void set_fat(uint32_t b, uint32_t v){
+	fat_table[b] = v;
+	mark_dirty(&fat_table[b], sizeof(uint32_t));
+}
+
+static void set_index(uint32_t i, int32_t v){
+	dir_index[i] = v;
+	mark_dirty(&dir_index[i], sizeof(int32_t));
+}
+
+static void mark_used(uint32_t b){
+	free_map[b / 64] &= ~(1ULL << (b % 64));
+	mark_dirty(&free_map[b / 64], sizeof(uint64_t));
+}
+static void mark_free(uint32_t b){
+	free_map[b / 64] |= 1ULL << (b % 64);
+	mark_dirty(&free_map[b / 64], sizeof(uint64_t));
+}
+static int  is_free(uint32_t b)  { return (free_map[b / 64] >> (b % 64)) & 1; }
+
+/**
+ * build_free_map - Rebuilds the free-space bitmap from the FAT table
+ * Block 0 is FAT_BAD from mkfs on: a FAT entry of 0 means "free", so block 0
+ * could not be linked as the next block of a chain.
+ */
+static void build_free_map(void){
+
+	memset(free_map, 0, (size_t)map_words * sizeof(uint64_t));
+	mark_dirty(free_map, (size_t)map_words * sizeof(uint64_t));
+	for(uint32_t i=1; i<num_blocks; i++){
+		if(fat_table[i] == FAT_FREE) mark_free(i);
+	}
+}
+
+/**
+ * find_free_block - Finds an unallocated block of group @g (next-fit)
+ * Scans the group's bitmap words a 64-bit word at a time, starting at its
+ * cursor and wrapping around once. Called with the group locked.
+ * Returns block index if found, or -1 if the group is full.
+ */
+static int find_free_block(AllocGroup *g){
+
+	uint32_t w = g->cursor / 64;
+	uint64_t word = free_map[w] & (~0ULL << (g->cursor % 64));	// Skip bits before the cursor
+
+	for(uint32_t n = 0; n <= g->end - g->first; n++){
+		if(word != 0){
+			uint32_t b = w * 64 + __builtin_ctzll(word);
+			if(b < num_blocks) return (int)b;
+		}
+		if(++w == g->end) w = g->first;
+		word = free_map[w];
+	}
+	return -1; // no free block
+}
+
+/**
+ * alloc_run - Allocates up to @want contiguous free blocks (an extent)
+ * Tries the allocation group picked by @hint first and the others in turn,
+ * so threads writing different files rarely wait for the same group.
+ * Within a group it takes the first free block at or after the cursor and
+ * extends the run while the following blocks are free, so a large write
+ * gets contiguous blocks.
+ * The blocks are marked used; the caller links them in the FAT.
+ * Returns the first block and sets *len, or -1 if the disk is full.
+ */
+static int alloc_run(uint32_t want, uint32_t *len, uint32_t hint){
+
+	for(uint32_t k = 0; k < ngroups; k++){
+		AllocGroup *g = &groups[(hint + k) % ngroups];
+		pthread_mutex_lock(&g->lock);
+		int start = find_free_block(g);
+		if(start < 0){
+			pthread_mutex_unlock(&g->lock);
+			continue;
+		}
+
+		uint64_t end = (uint64_t)g->end * 64 < num_blocks ? (uint64_t)g->end * 64 : num_blocks;
+		uint32_t n = 0;
+		while(n < want && start + n < end && is_free(start + n)){
+			mark_used(start + n);
+			n++;
+		}
+		g->cursor = start + n < end ? start + n : g->first * 64;
+		pthread_mutex_unlock(&g->lock);
+		*len = n;
+		return start;
+	}
+	return -1;
+}
+
+/**
+ * free_run - Returns @len blocks from @start that alloc_run handed out but
+ * nothing linked. A run never leaves its group.
+ */
+static void free_run(uint32_t start, uint32_t len){
+
+	uint32_t g = 0;
+	while(g + 1 < ngroups && start / 64 >= groups[g].end) g++;
+	pthread_mutex_lock(&groups[g].lock);
+	for(uint32_t k = 0; k < len; k++) mark_free(start + k);
+	pthread_mutex_unlock(&groups[g].lock);
+}
+
+/**
+ * name_hash - FNV-1a hash of a filename
+ */
+static uint32_t name_hash(const char *name){
+
+	uint32_t h = 2166136261u;
+	for(; *name; name++){
+		h ^= (unsigned char)*name;
+		h *= 16777619u;
+	}
+	return h;
+}
+
+/**
+ * dir_lookup - Finds the directory slot of a file through the hash index
+ * Returns the slot, or -1 if there is no such file.
+ */
+static int dir_lookup(const char *filename){
+
+	if(filename[0] == '\0') return -1;
+
+	uint32_t i = name_hash(filename) & (hash_slots - 1);
+	while(dir_index[i] != 0){
+		int slot = dir_index[i] - 1;
+		if(strcmp(directory[slot].filename, filename) == 0) return slot;
+		i = (i + 1) & (hash_slots - 1);
+	}
+	return -1;
+}
+
+static void dir_index_insert(int slot){
+
+	uint32_t i = name_hash(directory[slot].filename) & (hash_slots - 1);
+	while(dir_index[i] != 0) i = (i + 1) & (hash_slots - 1);
+	set_index(i, slot + 1);
+}
+
+/**
+ * dir_index_remove - Drops a slot from the index (backward-shift deletion)
+ * Entries after the hole that hash at or before it move back, so lookups
+ * never need tombstones.
+ */
+static void dir_index_remove(int slot){
+
+	uint32_t mask = hash_slots - 1;
+	uint32_t i = name_hash(directory[slot].filename) & mask;
+	while(dir_index[i] != slot + 1) i = (i + 1) & mask;
+
+	uint32_t j = i;
+	while(1){
+		j = (j + 1) & mask;
+		if(dir_index[j] == 0) break;
+		uint32_t home = name_hash(directory[dir_index[j] - 1].filename) & mask;
+		// Move j into the hole unless its home lies cyclically in (i, j]
+		if(((j - home) & mask) >= ((j - i) & mask)){
+			set_index(i, dir_index[j]);
+			i = j;
+		}
+	}
+	set_index(i, 0);
+}
+
+/**
+ * RunIter - Walks a byte range of a file block by block
+ */
+typedef struct{
+	uint32_t block;		// Block holding the next byte
+	uint32_t skip;		// Bytes of that block already consumed
+	uint64_t cluster;	// Index of block within the file
+	uint64_t at;		// Cluster of the piece last reported
+	int64_t  left;		// Bytes still to deliver
+}RunIter;
+
+/**
+ * drop_marks - Forgets the chain cache of @fl
+ * Called with open_lock held and no handle on the file.
+ */
+static void drop_marks(FileLock *fl){
+	free(fl->marks);
+	fl->marks = NULL;
+	fl->nmarks = fl->cap = 0;
+}
+
+/**
+ * note_cluster - Records that cluster @c of @of is block @b
+ */
+static void note_cluster(OpenFile *of, uint64_t c, uint32_t b){
+
+	FileLock *fl = of->fl;
+	if(c % CHAIN_STRIDE == 0){
+		pthread_mutex_lock(&fl->chain_lock);
+		if(c / CHAIN_STRIDE == fl->nmarks){
+			if(fl->nmarks == fl->cap){
+				fl->cap = fl->cap ? fl->cap * 2 : 16;
+				fl->marks = (uint32_t*)realloc(fl->marks, sizeof(uint32_t) * fl->cap);
+			}
+			fl->marks[fl->nmarks++] = b;
+		}
+		pthread_mutex_unlock(&fl->chain_lock);
+	}
+	of->cur_cluster = c;
+	of->cur_block = b;
+}
+
+/**
+ * chain_seek - Finds the block of cluster @c of an open file
+ * Walks from the nearest known position at or before @c: the last cluster
+ * the handle resolved, the file's mark below @c or the tail of the chain
+ * recorded in its directory entry. A seek costs fewer than CHAIN_STRIDE
+ * FAT hops once the marks cover it, and an append none at all. Stops
+ * early at the end of the chain.
+ * Returns the cluster reached and sets *block, or -1 on a corrupt chain.
+ */
+static int64_t chain_seek(OpenFile *of, uint64_t c, uint32_t *block){
+
+	const FileEntry *e = &directory[of->slot];
+	FileLock *fl = of->fl;
+	pthread_mutex_lock(&fl->chain_lock);
+	if(fl->nmarks == 0){
+		pthread_mutex_unlock(&fl->chain_lock);
+		note_cluster(of, 0, e->start_block);
+		pthread_mutex_lock(&fl->chain_lock);
+	}
+	uint64_t k = c / CHAIN_STRIDE;
+	if(k >= fl->nmarks) k = fl->nmarks - 1;
+	uint64_t at = k * CHAIN_STRIDE;
+	uint32_t b = fl->marks[k];
+	pthread_mutex_unlock(&fl->chain_lock);
+
+	if(of->cur_cluster <= c && of->cur_cluster > at){
+		at = of->cur_cluster;
+		b = of->cur_block;
+	}
+	if(e->tail_block != FAT_EOF && e->tail_cluster <= c && e->tail_cluster > at){
+		at = e->tail_cluster;
+		b = e->tail_block;
+	}
+
+	while(at < c){
+		if(b >= num_blocks) return -1;
+		if(fat_table[b] == FAT_EOF) break;
+		b = fat_table[b];
+		note_cluster(of, ++at, b);
+	}
+	if(b >= num_blocks) return -1;
+	of->cur_cluster = at;
+	of->cur_block = b;
+	*block = b;
+	return (int64_t)at;
+}
+
+static int run_iter_init(RunIter *it, OpenFile *of, int64_t off, int64_t len){
+
+	int64_t size = directory[of->slot].size;
+	if(off >= size) len = 0;
+	else if(len > size - off) len = size - off;
+
+	it->left = len;
+	it->cluster = off / block_size;
+	it->skip = (uint32_t)(off % block_size);
+	it->block = FAT_EOF;
+	if(len == 0) return 0;
+
+	int64_t at = chain_seek(of, it->cluster, &it->block);
+	if(at < 0) return -1;
+	if((uint64_t)at < it->cluster) it->left = 0;	// Chain shorter than the size
+	return 0;
+}
+
+/**
+ * run_iter_next - Reports the next piece of the range: @n bytes at @skip of @block
+ * Returns 1 for a piece, 0 at the end of the range, -1 on a corrupt chain.
+ */
+static int run_iter_next(RunIter *it, uint32_t *block, uint32_t *skip, uint32_t *n){
+
+	if(it->left == 0 || it->block == FAT_EOF) return 0;
+	if(it->block >= num_blocks) return -1;
+
+	int64_t len = block_size - it->skip;
+	if(len > it->left) len = it->left;
+	*block = it->block;
+	*skip = it->skip;
+	*n = (uint32_t)len;
+	it->at = it->cluster;
+
+	it->left -= len;
+	it->skip += (uint32_t)len;
+	if(it->skip == block_size && it->left > 0){
+		it->block = fat_table[it->block];
+		it->cluster++;
+		it->skip = 0;
+	}
+	return 1;
+}
+
+/**
+ * sequential - Whether a read of @len bytes at @off is worth reading ahead for
+ * It is when it starts where the previous read of the handle ended, or
+ * when it is long enough to be a stream by itself.
+ */
+static int sequential(const OpenFile *of, int64_t off, size_t len){
+	return (uint64_t)(off / block_size) == of->ra_next || len > (size_t)RA_MIN * block_size;
+}
+
+/**
+ * read_ahead - Prefetches the blocks after cluster @c (block @b) for a sequential reader
+ * The window doubles from RA_MIN to RA_MAX blocks each time the reader
+ * gets within half a window of the blocks already requested; a jump
+ * resets it, and a read that is not @seq fetches nothing ahead.
+ */
+static void read_ahead(OpenFile *of, uint64_t c, uint32_t b, int seq){
+
+	if(c != of->ra_next){		// Jumped: what was read ahead is elsewhere
+		of->ra_window = 0;
+		of->ra_end = c + 1;
+	}
+	of->ra_next = c + 1;
+	if(!seq) return;
+	if(of->ra_window > 0 && c + of->ra_window / 2 < of->ra_end) return;
+
+	uint32_t window = of->ra_window ? of->ra_window * 2 : RA_MIN;
+	if(window > RA_MAX) window = RA_MAX;
+	of->ra_window = window;
+
+	uint32_t blocks[RA_MAX];
+	int n = 0;
+	uint64_t at = c;
+	while(at < c + window){
+		uint32_t next = fat_table[b];
+		if(next >= num_blocks) break;	// End of the chain
+		b = next;
+		if(++at >= of->ra_end) blocks[n++] = b;
+	}
+	if(at + 1 > of->ra_end) of->ra_end = at + 1;
+	bc_readahead(blocks, n);
+}
+
+/**
+ * write_runs - writev()s @n runs to @out, resuming after partial writes
+ */
+static int write_runs(int out, struct iovec *iov, int n){
+
+	while(n > 0){
+		ssize_t w = writev(out, iov, n);
+		if(w < 0) return -1;
+		while(n > 0 && (size_t)w >= iov->iov_len){
+			w -= iov->iov_len;
+			iov++;
+			n--;
+		}
+		if(n > 0){
+			iov->iov_base = (char*)iov->iov_base + w;
+			iov->iov_len -= w;
+		}
+	}
+	return 0;
+}
+
+/**
+ * TxnHeader / TxnCommit - Frame of one journal transaction
+ * A transaction is the header, nrec records (sector number, sector image)
+ * and the commit trailer. crc covers the header and every record, so a
+ * transaction torn by a crash fails the check and is not replayed.
+ */
+typedef struct{
+	uint32_t magic;		// JNL_MAGIC
+	uint32_t nrec;
+	uint64_t seq;
+}TxnHeader;
+
+typedef struct{
+	uint32_t magic;		// JNL_COMMIT
+	uint32_t crc;
+	uint64_t seq;		// Same as the header's
+}TxnCommit;
+
+/**
+ * crc32 - Updates the CRC-32 (IEEE, reflected) @crc with @len bytes
+ */
+static uint32_t crc32(uint32_t crc, const void *p, size_t len){
+
+	static uint32_t table[256];
+	if(table[1] == 0){
+		for(uint32_t i = 0; i < 256; i++){
+			uint32_t c = i;
+			for(int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+			table[i] = c;
+		}
+	}
+	const unsigned char *b = p;
+	crc = ~crc;
+	while(len-- > 0) crc = table[(crc ^ *b++) & 0xFF] ^ (crc >> 8);
+	return ~crc;
+}
+
+static int pwrite_all(int fd, const void *buf, size_t len, off_t off){
+
+	const char *p = buf;
+	while(len > 0){
+		ssize_t w = pwrite(fd, p, len, off);
+		if(w < 0) return -1;
+		p += w;
+		off += w;
+		len -= w;
+	}
+	return 0;
+}
+
+/**
+ * journal_commit - Appends the metadata sectors of @l as one transaction
+ * The transaction is durable, and the changes in it committed, once the
+ * single fdatasync at the end returns.
+ */
+static int journal_commit(const RangeList *l){
+
+	uint32_t nrec = 0;
+	for(size_t k = 0; k < l->n; k++) nrec += l->r[k].last - l->r[k].first + 1;
+
+	TxnHeader hd = { JNL_MAGIC, nrec, jnl_seq + 1 };
+	uint64_t *sectors = (uint64_t*)malloc(sizeof(uint64_t) * (nrec ? nrec : 1));
+	if(sectors == NULL) return FAT_EIO;
+	struct iovec iov[IOV_BATCH];
+	int n = 0, err = 0;
+	uint32_t crc = crc32(0, &hd, sizeof(hd));
+
+	iov[n].iov_base = &hd;
+	iov[n++].iov_len = sizeof(hd);
+	// Append after the last committed transaction; a torn earlier attempt is overwritten
+	if(lseek(jnl_fd, (off_t)jnl_size, SEEK_SET) < 0) err = -1;
+	uint32_t r = 0;
+	for(size_t k = 0; k < l->n && !err; k++){
+		for(uint64_t s = l->r[k].first; s <= l->r[k].last && !err; s++, r++){
+			sectors[r] = s;
+			crc = crc32(crc, &sectors[r], sizeof(uint64_t));
+			crc = crc32(crc, image + s * FS_SECTOR, FS_SECTOR);
+			iov[n].iov_base = &sectors[r];
+			iov[n++].iov_len = sizeof(uint64_t);
+			iov[n].iov_base = image + s * FS_SECTOR;
+			iov[n++].iov_len = FS_SECTOR;
+			if(n + 2 > IOV_BATCH){
+				err = write_runs(jnl_fd, iov, n);
+				n = 0;
+			}
+		}
+	}
+	TxnCommit cm = { JNL_COMMIT, crc, hd.seq };
+	iov[n].iov_base = &cm;
+	iov[n++].iov_len = sizeof(cm);
+	if(!err) err = write_runs(jnl_fd, iov, n);
+	free(sectors);
+	if(err != 0 || fdatasync(jnl_fd) != 0) return FAT_EIO;
+
+	jnl_seq = hd.seq;
+	jnl_size += sizeof(hd) + (uint64_t)nrec * JNL_REC + sizeof(cm);
+	return FAT_OK;
+}
+
+/**
+ * journal_replay - Applies every complete transaction of the journal to the image
+ * Stops at the first transaction that is short, fails its checksum or does
+ * not follow its predecessor's sequence number: it was never committed. Returns 1 if the journal was not empty (the image
+ * was not unmounted cleanly), 0 if it was, or a negative FAT_E* code.
+ */
+static int journal_replay(uint64_t image_size){
+
+	struct stat st;
+	if(fstat(jnl_fd, &st) != 0) return FAT_EIO;
+	if(st.st_size == 0) return 0;
+
+	char *rec = (char*)malloc(JNL_REC);
+	if(rec == NULL) return FAT_EIO;
+	off_t pos = 0;
+	uint64_t prev = 0;
+	for(;;){
+		TxnHeader hd;
+		if(pread(jnl_fd, &hd, sizeof(hd), pos) != (ssize_t)sizeof(hd) || hd.magic != JNL_MAGIC) break;
+		if(pos > 0 && hd.seq != prev + 1) break;
+		off_t body = pos + (off_t)sizeof(hd);
+		off_t end = body + (off_t)hd.nrec * (off_t)JNL_REC;
+		if(end + (off_t)sizeof(TxnCommit) > st.st_size) break;
+
+		// First pass checks the transaction, the second applies it
+		uint32_t crc = crc32(0, &hd, sizeof(hd));
+		uint32_t k;
+		for(k = 0; k < hd.nrec; k++){
+			if(pread(jnl_fd, rec, JNL_REC, body + (off_t)k * JNL_REC) != (ssize_t)JNL_REC) break;
+			crc = crc32(crc, rec, JNL_REC);
+		}
+		TxnCommit cm;
+		if(k < hd.nrec || pread(jnl_fd, &cm, sizeof(cm), end) != (ssize_t)sizeof(cm) ||
+		   cm.magic != JNL_COMMIT || cm.seq != hd.seq || cm.crc != crc) break;
+
+		for(k = 0; k < hd.nrec; k++){
+			uint64_t s;
+			if(pread(jnl_fd, rec, JNL_REC, body + (off_t)k * JNL_REC) != (ssize_t)JNL_REC) break;
+			memcpy(&s, rec, sizeof(s));
+			if((s + 1) * FS_SECTOR > image_size) continue;
+			if(pwrite_all(fs_fd, rec + sizeof(s), FS_SECTOR, (off_t)(s * FS_SECTOR)) != 0){
+				free(rec);
+				return FAT_EIO;
+			}
+		}
+		pos = end + (off_t)sizeof(cm);
+		prev = hd.seq;
+	}
+	free(rec);
+
+	if(fdatasync(fs_fd) != 0 || ftruncate(jnl_fd, 0) != 0 || fsync(jnl_fd) != 0) return FAT_EIO;
+	return 1;
+}
+
+/**
+ * checkpoint - Copies the journaled sectors home and empties the journal
+ * Only called right after a commit, so the metadata mapping holds nothing
+ * that is not in the journal yet.
+ */
+static int checkpoint(void){
+
+	if(jnl_size == 0) return FAT_OK;
+	range_merge(&logged);
+	for(size_t k = 0; k < logged.n; k++){
+		uint64_t first = logged.r[k].first, last = logged.r[k].last;
+		if(pwrite_all(fs_fd, image + first * FS_SECTOR, (last - first + 1) * FS_SECTOR,
+		              (off_t)(first * FS_SECTOR)) != 0) return FAT_EIO;
+	}
+	if(fdatasync(fs_fd) != 0 || ftruncate(jnl_fd, 0) != 0 || fsync(jnl_fd) != 0) return FAT_EIO;
+	logged.n = 0;
+	jnl_size = 0;
+	return FAT_OK;
+}
+
+/**
+ * load_directory - Validates the directory index and collects free slots
+ * Only run after an unclean shutdown. The index is rebuilt when it does
+ * not match the directory, so a lookup can always trust it.
+ */
+static void load_directory(void){
+
+	uint32_t used = 0;
+	int valid = 1;
+	sb->nfree_slots = 0;
+	for(int i = (int)max_files - 1; i >= 0; i--){
+		if(directory[i].filename[0] == '\0'){
+			free_slots[sb->nfree_slots++] = i;
+			continue;
+		}
+		if(directory[i].filename[MAX_FILE_NAME - 1] != '\0'){
+			directory[i].filename[MAX_FILE_NAME - 1] = '\0';
+			mark_dirty(&directory[i], sizeof(FileEntry));
+		}
+		uint32_t t = directory[i].tail_block;
+		if(t != FAT_EOF && (t >= num_blocks || fat_table[t] != FAT_EOF)){
+			directory[i].tail_block = FAT_EOF;		// chain_seek walks instead
+			mark_dirty(&directory[i], sizeof(FileEntry));
+		}
+		used++;
+		if(valid && dir_lookup(directory[i].filename) != i) valid = 0;
+	}
+	mark_dirty(free_slots, (size_t)max_files * sizeof(int32_t));
+
+	uint32_t indexed = 0;
+	for(uint32_t i = 0; valid && i < hash_slots; i++){
+		int32_t v = dir_index[i];
+		if(v < 0 || (uint32_t)v > max_files || (v > 0 && directory[v - 1].filename[0] == '\0')) valid = 0;
+		else if(v > 0) indexed++;
+	}
+
+	if(!valid || indexed != used){
+		printf("Warning : directory index rebuilt.\n");
+		memset(dir_index, 0, (size_t)hash_slots * sizeof(int32_t));
+		mark_dirty(dir_index, (size_t)hash_slots * sizeof(int32_t));
+		for(uint32_t i = 0; i < max_files; i++){
+			if(directory[i].filename[0] != '\0') dir_index_insert(i);
+		}
+	}
+}
+
+/**
+ * journal_path - "<image>.journal", malloc()ed
+ */
+static char *journal_path(const char *path){
+
+	char *p = (char*)malloc(strlen(path) + sizeof(".journal"));
+	if(p != NULL) sprintf(p, "%s.journal", path);
+	return p;
+}
+
+/**
+ * fat_mkfs - Creates an empty file system at @path (NULL @g: defaults)
+ * The image is sized sparse; only the superblock, free map and free-slot
+ * stack are written, the zeroed FAT and directory already mean "empty".
+ * A fresh image has nothing to protect, so this bypasses the journal and
+ * removes any journal left by an older image at @path.
+ */
+int fat_mkfs(const char *path, const FatGeometry *g){
+
+	FatGeometry def = { FAT_DEFAULT_BLOCK_SIZE, FAT_DEFAULT_BLOCKS, FAT_DEFAULT_FILES };
+	if(g == NULL) g = &def;
+	if(!valid_geometry(g->num_blocks, g->block_size, g->max_files)) return FAT_EINVAL;
+
+	SuperBlock head;
+	memset(&head, 0, sizeof(head));
+	layout(&head, g->num_blocks, g->block_size, g->max_files);
+
+	char *jpath = journal_path(path);
+	if(jpath == NULL) return FAT_EIO;
+	if(unlink(jpath) != 0 && errno != ENOENT){
+		free(jpath);
+		return FAT_EIO;
+	}
+	free(jpath);
+
+	fs_fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if(fs_fd < 0) return FAT_EIO;
+	if(ftruncate(fs_fd, (off_t)head.image_size) != 0 ||
+	   pwrite(fs_fd, &head, sizeof(head), 0) != (ssize_t)sizeof(head) || map_image(&head) != FAT_OK){
+		close(fs_fd);
+		return FAT_EIO;
+	}
+
+	sb->magic = FS_MAGIC;
+	sb->version = FS_VERSION;
+	mark_dirty(sb, sizeof(*sb));
+	set_fat(0, FAT_BAD);
+
+	memset(free_map, 0xFF, (size_t)map_words * sizeof(uint64_t));
+	mark_dirty(free_map, (size_t)map_words * sizeof(uint64_t));
+	mark_used(0);
+	for(uint32_t b = num_blocks; b < map_words * 64; b++) mark_used(b);
+
+	for(uint32_t k = 0; k < max_files; k++) free_slots[k] = max_files - 1 - k;
+	mark_dirty(free_slots, (size_t)max_files * sizeof(int32_t));
+	sb->nfree_slots = max_files;
+
+	int err = FAT_OK;
+	RangeList all = { NULL, 0, 0 };
+	collect_dirty(&all);
+	for(size_t k = 0; k < all.n && err == FAT_OK; k++){
+		uint64_t first = all.r[k].first, last = all.r[k].last;
+		if(pwrite_all(fs_fd, image + first * FS_SECTOR, (last - first + 1) * FS_SECTOR,
+		              (off_t)(first * FS_SECTOR)) != 0) err = FAT_EIO;
+	}
+	free(all.r);
+	if(err == FAT_OK && fsync(fs_fd) != 0) err = FAT_EIO;
+	unmap_image();
+	return err;
+}
+
+/**
+ * valid_superblock - Checks a superblock against its own layout and the image size
+ */
+static int valid_superblock(const SuperBlock *s, off_t file_size){
+
+	if(s->magic != FS_MAGIC || s->version != FS_VERSION) return 0;
+	if(!valid_geometry(s->num_blocks, s->block_size, s->max_files)) return 0;
+
+	SuperBlock l;
+	layout(&l, s->num_blocks, s->block_size, s->max_files);
+	return l.hash_slots == s->hash_slots && l.fat_offset == s->fat_offset && l.dir_offset == s->dir_offset &&
+	       l.index_offset == s->index_offset && l.map_offset == s->map_offset &&
+	       l.slots_offset == s->slots_offset && l.data_offset == s->data_offset &&
+	       l.image_size == s->image_size && (uint64_t)file_size == s->image_size;
+}
+
+/**
+ * fat_mount - Maps the image at @path, creating a default one if there is none
+ * Mount, mkfs and unmount must not run alongside other calls.
+ * Pages are read on first touch, so a command only reads the sectors it uses.
+ * Committed transactions left in the journal are replayed first; if there
+ * were any, the free map and free-slot stack are rebuilt, since the
+ * session that wrote them did not end with an unmount.
+ */
+int fat_mount(const char *path){
+
+	fs_fd = open(path, O_RDWR);
+	if(fs_fd < 0){
+		printf("Warning : No saved state found. Starting fresh.\n");
+		FatGeometry fresh = { FAT_FRESH_BLOCK_SIZE, FAT_FRESH_BLOCKS, FAT_FRESH_FILES };
+		int err = fat_mkfs(path, &fresh);
+		if(err != FAT_OK) return err;
+		fs_fd = open(path, O_RDWR);
+		if(fs_fd < 0) return FAT_EIO;
+	}
+
+	char *jpath = journal_path(path);
+	if(jpath != NULL) jnl_fd = open(jpath, O_RDWR | O_CREAT, 0644);
+	free(jpath);
+	struct stat st;
+	if(jnl_fd < 0 || fstat(fs_fd, &st) != 0){
+		if(jnl_fd >= 0) close(jnl_fd);
+		jnl_fd = -1;
+		close(fs_fd);
+		return FAT_EIO;
+	}
+	int unclean = journal_replay(st.st_size);
+
+	SuperBlock head;
+	int err = FAT_OK;
+	if(unclean < 0) err = unclean;
+	else if(pread(fs_fd, &head, sizeof(head), 0) != (ssize_t)sizeof(head) || !valid_superblock(&head, st.st_size))
+		err = FAT_EINVAL;
+	else if(map_image(&head) != FAT_OK) err = FAT_EIO;
+	if(err != FAT_OK){
+		close(jnl_fd);
+		jnl_fd = -1;
+		close(fs_fd);
+		return err;
+	}
+	if(bc_init(fs_fd, head.data_offset, head.block_size, head.num_blocks, cache_bytes) != FAT_OK){
+		unmap_image();
+		close(jnl_fd);
+		jnl_fd = -1;
+		return FAT_EIO;
+	}
+
+	jnl_seq = 0;
+	jnl_size = 0;
+	if(unclean){
+		build_free_map();
+		load_directory();
+	}
+	memset(handles, 0, sizeof(handles));
+	for(int k = 0; k < FAT_MAX_OPEN; k++){
+		file_locks[k].slot = -1;
+		file_locks[k].refs = 0;
+		pthread_rwlock_init(&file_locks[k].lock, NULL);
+		pthread_mutex_init(&file_locks[k].chain_lock, NULL);
+		file_locks[k].marks = NULL;
+		file_locks[k].nmarks = file_locks[k].cap = 0;
+	}
+	return FAT_OK;
+}
+
+/**
+ * release_frees - Returns the blocks freed in the committed transaction to the free map
+ * Until then the old chain still owns them on disk, so they must not be
+ * handed out and overwritten.
+ */
+static void release_frees(void){
+
+	for(size_t k = 0; k < npending; k++) mark_free(pending_free[k]);
+	npending = 0;
+}
+
+/**
+ * fat_sync - Commits everything changed since the last sync
+ * Ordered like a metadata journal: dirty file blocks are written back
+ * first, then the metadata sectors go to the journal as one transaction,
+ * so a committed FAT or directory entry never points at data not yet on
+ * disk. Waits for the operations in progress and holds off new ones
+ * meanwhile.
+ */
+static int sync_image(void){
+
+	if(bc_flush() != 0) return FAT_EIO;
+
+	RangeList meta = { NULL, 0, 0 };
+	collect_dirty(&meta);
+	if(meta.n == 0) return FAT_OK;
+	range_add(&meta, 0, 0);		// The superblock counters change without marking
+	range_merge(&meta);
+
+	int err = journal_commit(&meta);
+	if(err == FAT_OK){
+		for(size_t k = 0; k < meta.n; k++) range_add(&logged, meta.r[k].first, meta.r[k].last);
+		release_frees();
+		if(jnl_size >= JOURNAL_CHECKPOINT) err = checkpoint();
+	}
+	free(meta.r);
+	return err;
+}
+
+int fat_sync(void){
+
+	pthread_rwlock_wrlock(&fs_lock);
+	int err = sync_image();
+	pthread_rwlock_unlock(&fs_lock);
+	return err;
+}
+
+/**
+ * fat_unmount - Commits, checkpoints, drops the cache and unmaps
+ * The frees released by the last commit dirty the free map, hence the second sync.
+ */
+int fat_unmount(void){
+
+	for(int h = 0; h < FAT_MAX_OPEN; h++) fat_close(h);
+	for(int k = 0; k < FAT_MAX_OPEN; k++){
+		pthread_rwlock_destroy(&file_locks[k].lock);
+		pthread_mutex_destroy(&file_locks[k].chain_lock);
+		drop_marks(&file_locks[k]);
+	}
+	int err = sync_image();
+	if(err == FAT_OK) err = sync_image();
+	if(err == FAT_OK) err = checkpoint();
+	bc_destroy();
+	unmap_image();
+	close(jnl_fd);
+	jnl_fd = -1;
+	return err;
+}
+
+int fat_geometry(FatGeometry *g){
+
+	g->block_size = block_size;
+	g->num_blocks = num_blocks;
+	g->max_files = max_files;
+	return FAT_OK;
+}
+
+int fat_set_cache(size_t bytes){
+
+	cache_bytes = bytes ? bytes : FAT_DEFAULT_CACHE;
+	return FAT_OK;
+}
+
+int fat_cache_stats(FatCacheStats *st){
+
+	bc_stats(st);
+	return FAT_OK;
+}
+
+static int valid_name(const char *name){
+	return name[0] != '\0' && strlen(name) < MAX_FILE_NAME;
+}
+
+static int create_locked(const char *name){
+
+	if(dir_lookup(name) >= 0) return FAT_EEXIST;
+	if(sb->nfree_slots == 0) return FAT_ENOSPC;
+
+	int i = free_slots[sb->nfree_slots - 1];
+	uint32_t len;
+	int j = alloc_run(1, &len, i);
+	if(j < 0) return FAT_ENOSPC;
+	set_fat(j, FAT_EOF);
+
+	sb->nfree_slots--;
+	strcpy(directory[i].filename, name);
+	directory[i].start_block = j;
+	directory[i].tail_block = j;
+	directory[i].tail_cluster = 0;
+	directory[i].size = 0;
+	mark_dirty(&directory[i], sizeof(FileEntry));
+	dir_index_insert(i);
+	return FAT_OK;
+}
+
+/**
+ * fat_create - Registers a new, empty file
+ * Takes the lowest free directory slot and one block for the chain head.
+ */
+int fat_create(const char *name){
+
+	if(!valid_name(name)) return FAT_EINVAL;
+	pthread_rwlock_rdlock(&fs_lock);
+	pthread_rwlock_wrlock(&dir_lock);
+	int err = create_locked(name);
+	pthread_rwlock_unlock(&dir_lock);
+	pthread_rwlock_unlock(&fs_lock);
+	return err;
+}
+
+/**
+ * is_open - Whether a handle refers to directory slot @slot
+ * Called with open_lock held.
+ */
+static int is_open(int slot){
+
+	for(int h = 0; h < FAT_MAX_OPEN; h++){
+		if(handles[h].used && handles[h].slot == slot) return 1;
+	}
+	return 0;
+}
+
+static void defer_free(uint32_t b){
+
+	if(npending == pending_cap){
+		pending_cap = pending_cap ? pending_cap * 2 : 256;
+		pending_free = (uint32_t*)realloc(pending_free, sizeof(uint32_t) * pending_cap);
+	}
+	pending_free[npending++] = b;
+}
+
+static int delete_locked(const char *name){
+
+	int i = dir_lookup(name);
+	if(i < 0) return FAT_ENOENT;
+	// fat_open looks up under dir_lock, so no handle can appear after this check
+	pthread_mutex_lock(&open_lock);
+	int busy = is_open(i);
+	for(int k = 0; !busy && k < FAT_MAX_OPEN; k++){
+		if(file_locks[k].slot == i) drop_marks(&file_locks[k]);
+	}
+	pthread_mutex_unlock(&open_lock);
+	if(busy) return FAT_EBUSY;
+
+	// Release all linked blocks in FAT
+	uint32_t block = directory[i].start_block;
+	while(block != FAT_EOF && block < num_blocks && block != 0){
+		uint32_t next_block = fat_table[block];
+		set_fat(block, FAT_FREE); // Mark as free
+		defer_free(block);
+		block = next_block;
+	}
+
+	dir_index_remove(i);
+	directory[i].filename[0] = '\0';	// Invalidate directory entry
+	mark_dirty(&directory[i], sizeof(FileEntry));
+	free_slots[sb->nfree_slots] = i;
+	mark_dirty(&free_slots[sb->nfree_slots++], sizeof(int32_t));
+	return FAT_OK;
+}
+
+/**
+ * fat_delete - Removes a file and releases its blocks back to the FAT
+ */
+int fat_delete(const char *name){
+
+	pthread_rwlock_rdlock(&fs_lock);
+	pthread_rwlock_wrlock(&dir_lock);
+	int err = delete_locked(name);
+	pthread_rwlock_unlock(&dir_lock);
+	pthread_rwlock_unlock(&fs_lock);
+	return err;
+}
+
+/**
+ * fat_stat - Reports a file by name
+ * The size is read atomically: a writer of the file may be extending it.
+ */
+int fat_stat(const char *name, FatStat *st){
+
+	pthread_rwlock_rdlock(&dir_lock);
+	int i = dir_lookup(name);
+	if(i >= 0){
+		strcpy(st->name, directory[i].filename);
+		st->size = __atomic_load_n(&directory[i].size, __ATOMIC_RELAXED);
+	}
+	pthread_rwlock_unlock(&dir_lock);
+	return i < 0 ? FAT_ENOENT : FAT_OK;
+}
+
+/**
+ * fat_readdir - Reports the next file at or after directory slot *pos
+ */
+int fat_readdir(int *pos, FatStat *st){
+
+	int found = 0;
+	pthread_rwlock_rdlock(&dir_lock);
+	for(; (uint32_t)*pos < max_files; (*pos)++){
+		if(directory[*pos].filename[0] != '\0'){
+			strcpy(st->name, directory[*pos].filename);
+			st->size = __atomic_load_n(&directory[*pos].size, __ATOMIC_RELAXED);
+			(*pos)++;
+			found = 1;
+			break;
+		}
+	}
+	pthread_rwlock_unlock(&dir_lock);
+	return found;
+}
+
+static OpenFile *get_handle(int h){
+	if(h < 0 || h >= FAT_MAX_OPEN || !handles[h].used) return NULL;
+	return &handles[h];
+}
+
+static void lock_file(OpenFile *of, int write){
+	pthread_rwlock_rdlock(&fs_lock);
+	if(write) pthread_rwlock_wrlock(&of->fl->lock);
+	else pthread_rwlock_rdlock(&of->fl->lock);
+}
+
+static void unlock_file(OpenFile *of){
+	pthread_rwlock_unlock(&of->fl->lock);
+	pthread_rwlock_unlock(&fs_lock);
+}
+
+/**
+ * fat_open - Opens a handle on a file at position 0
+ * Handles on the same file share its FileLock.
+ */
+int fat_open(const char *name){
+
+	pthread_rwlock_rdlock(&dir_lock);
+	int i = dir_lookup(name);
+	if(i < 0){
+		pthread_rwlock_unlock(&dir_lock);
+		return FAT_ENOENT;
+	}
+
+	pthread_mutex_lock(&open_lock);
+	int h, k, spare = -1;
+	for(h = 0; h < FAT_MAX_OPEN && handles[h].used; h++);
+	for(k = 0; k < FAT_MAX_OPEN; k++){
+		if(file_locks[k].slot == i && (file_locks[k].refs > 0 || file_locks[k].nmarks > 0)) break;
+		// Prefer a lock whose cache is empty over evicting another file's
+		if(file_locks[k].refs == 0 && (spare < 0 || file_locks[spare].nmarks > file_locks[k].nmarks)) spare = k;
+	}
+	if(h < FAT_MAX_OPEN){		// A free handle means a free file lock too
+		if(k == FAT_MAX_OPEN){
+			k = spare;
+			drop_marks(&file_locks[k]);
+			file_locks[k].slot = i;
+		}
+		file_locks[k].refs++;
+		memset(&handles[h], 0, sizeof(OpenFile));
+		handles[h].slot = i;
+		handles[h].fl = &file_locks[k];
+		handles[h].used = 1;
+	}
+	pthread_mutex_unlock(&open_lock);
+	pthread_rwlock_unlock(&dir_lock);
+	return h < FAT_MAX_OPEN ? h : FAT_ENOSPC;
+}
+
+int fat_close(int h){
+
+	OpenFile *of = get_handle(h);
+	if(of == NULL) return FAT_EBADF;
+	pthread_mutex_lock(&open_lock);
+	of->fl->refs--;
+	memset(of, 0, sizeof(OpenFile));
+	pthread_mutex_unlock(&open_lock);
+	return FAT_OK;
+}
+
+long fat_seek(int h, long off, int whence){
+
+	OpenFile *of = get_handle(h);
+	if(of == NULL) return FAT_EBADF;
+
+	pthread_rwlock_rdlock(&of->fl->lock);
+	long size = directory[of->slot].size;
+	pthread_rwlock_unlock(&of->fl->lock);
+
+	long base = 0;
+	if(whence == SEEK_CUR) base = of->pos;
+	else if(whence == SEEK_END) base = size;
+	else if(whence != SEEK_SET) return FAT_EINVAL;
+	if(off < -base || base + off > size) return FAT_EINVAL;
+	of->pos = base + off;
+	return of->pos;
+}
+
+/**
+ * fat_pread - Copies up to @len bytes at @off of an open file into @buf
+ * The data is copied out of the block cache, one memcpy per block, with
+ * read-ahead for sequential readers. Returns the number of bytes read
+ * (0 at end of file).
+ */
+static ssize_t pread_locked(OpenFile *of, void *buf, size_t len, off_t off){
+
+	RunIter it;
+	size_t done = 0;
+	uint32_t block, skip, n;
+	int r, frame;
+	int seq = sequential(of, off, len);
+	if(run_iter_init(&it, of, off, (int64_t)len) != 0) return FAT_ECORRUPT;
+	while((r = run_iter_next(&it, &block, &skip, &n)) > 0){
+		read_ahead(of, it.at, block, seq);
+		char *p = bc_get(block, BC_READ, &frame);
+		if(p == NULL) return FAT_EIO;
+		memcpy((char*)buf + done, p + skip, n);
+		bc_put(frame, 0);
+		done += n;
+	}
+	if(r == 0 && it.block < num_blocks) note_cluster(of, it.cluster, it.block);
+	return r < 0 ? FAT_ECORRUPT : (ssize_t)done;
+}
+
+ssize_t fat_pread(int h, void *buf, size_t len, off_t off){
+
+	OpenFile *of = get_handle(h);
+	if(of == NULL) return FAT_EBADF;
+	if(off < 0) return FAT_EINVAL;
+
+	lock_file(of, 0);
+	ssize_t n = pread_locked(of, buf, len, off);
+	unlock_file(of);
+	return n;
+}
+
+ssize_t fat_read(int h, void *buf, size_t len){
+
+	OpenFile *of = get_handle(h);
+	if(of == NULL) return FAT_EBADF;
+	ssize_t n = fat_pread(h, buf, len, of->pos);
+	if(n > 0) of->pos += n;
+	return n;
+}
+
+/**
+ * fat_sendfile - Writes up to @len bytes from the position of @h to @out_fd
+ * The cached blocks go to the kernel directly, pinned BC_PIN_MAX at a time
+ * for each writev.
+ * Returns the number of bytes written.
+ */
+static ssize_t sendfile_locked(int out_fd, OpenFile *of, size_t len){
+
+	RunIter it;
+	struct iovec iov[BC_PIN_MAX];
+	int frames[BC_PIN_MAX];
+	int n = 0, r = 0, err = 0;
+	size_t done = 0;
+	uint32_t block, skip, cnt;
+	int seq = sequential(of, of->pos, len);
+	if(run_iter_init(&it, of, of->pos, (int64_t)len) != 0) return FAT_ECORRUPT;
+	while(!err && (r = run_iter_next(&it, &block, &skip, &cnt)) > 0){
+		read_ahead(of, it.at, block, seq);
+		char *p = bc_get(block, BC_READ, &frames[n]);
+		if(p == NULL){
+			err = FAT_EIO;
+			break;
+		}
+		iov[n].iov_base = p + skip;
+		iov[n].iov_len = cnt;
+		done += cnt;
+		if(++n == BC_PIN_MAX || it.left == 0){
+			if(write_runs(out_fd, iov, n) != 0) err = FAT_EIO;
+			while(n > 0) bc_put(frames[--n], 0);
+		}
+	}
+	if(n > 0 && !err && write_runs(out_fd, iov, n) != 0) err = FAT_EIO;
+	while(n > 0) bc_put(frames[--n], 0);
+	if(err) return err;
+	if(r == 0 && it.block < num_blocks) note_cluster(of, it.cluster, it.block);
+	of->pos += done;
+	return r < 0 ? FAT_ECORRUPT : (ssize_t)done;
+}
+
+ssize_t fat_sendfile(int out_fd, int h, size_t len){
+
+	OpenFile *of = get_handle(h);
+	if(of == NULL) return FAT_EBADF;
+
+	lock_file(of, 0);
+	ssize_t n = sendfile_locked(out_fd, of, len);
+	unlock_file(of);
+	return n;
+}
+
+/**
+ * fat_write - Writes @len bytes at the position of @h
+ * Logic:
+ * - Walks the chain to the block holding the position, overwrites the
+ *   blocks that already exist and links new ones once the chain ends.
+ * - New blocks come from alloc_run as one extent for the rest of the data.
+ * - Data goes into the block cache and is written back by fat_sync or
+ *   on eviction.
+ * Returns the bytes written, short if the disk filled up.
+ */
+static ssize_t write_locked(OpenFile *of, const void *buf, size_t len){
+
+	FileEntry *e = &directory[of->slot];
+	const char *data = buf;
+
+	// Find the block holding the position (the last one if the position is
+	// just past a full last block)
+	uint32_t block;
+	int64_t cluster = chain_seek(of, of->pos / block_size, &block);
+	if(cluster < 0) return FAT_ECORRUPT;
+	int64_t offset_in_block = of->pos - cluster * block_size;
+
+	size_t bytes_written = 0;
+	uint32_t run_next = 0, run_left = 0;	// Extent allocated ahead for this write
+	int grown = 0;							// The tail or the size moved
+	int err = 0;
+
+	while(bytes_written < len){
+		// Move on to the next block once the current one is full
+		int64_t space_in_block = block_size - offset_in_block;
+		if(space_in_block <= 0){
+			uint32_t next = fat_table[block];
+			if(next == FAT_EOF){
+				// 체인 끝이면 남은 데이터가 필요로 하는 블록 수만큼 연속 구간을 한 번에 할당
+				if(run_left == 0){
+					uint64_t need = (len - bytes_written + block_size - 1) / block_size;
+					int start = alloc_run(need < num_blocks ? (uint32_t)need : num_blocks, &run_left, of->slot);
+					if(start < 0) break;
+					run_next = start;
+				}
+				next = run_next++;
+				run_left--;
+				set_fat(block, next);
+				set_fat(next, FAT_EOF);
+				e->tail_block = next;
+				e->tail_cluster = (uint32_t)cluster + 1;
+				grown = 1;
+			}
+			else if(next >= num_blocks) return FAT_ECORRUPT;
+			block = next;
+			note_cluster(of, ++cluster, block);
+			offset_in_block = 0;
+			space_in_block = block_size;
+		}
+
+		size_t to_write = len - bytes_written;
+		if(to_write > (size_t)space_in_block) to_write = space_in_block;
+
+		// Only read the block in if part of its old contents survives
+		int mode = BC_READ, frame;
+		if((uint64_t)cluster * block_size >= (uint64_t)e->size) mode = BC_NEW;
+		else if(offset_in_block == 0 && to_write == block_size) mode = BC_OVERWRITE;
+		char *dst = bc_get(block, mode, &frame);
+		if(dst == NULL){
+			err = FAT_EIO;
+			break;
+		}
+		memcpy(dst + offset_in_block, &data[bytes_written], to_write);
+		bc_put(frame, 1);
+
+		bytes_written   += to_write;
+		offset_in_block += to_write;
+	}
+
+	// Blocks of the extent the write stopped short of
+	if(run_left > 0) free_run(run_next, run_left);
+
+	of->pos += bytes_written;
+	if(of->pos > e->size){
+		__atomic_store_n(&e->size, of->pos, __ATOMIC_RELAXED);
+		grown = 1;
+	}
+	if(grown) mark_dirty(e, sizeof(FileEntry));
+	if(bytes_written == 0 && len > 0) return err ? err : FAT_ENOSPC;
+	return bytes_written;
+}
+
+ssize_t fat_write(int h, const void *buf, size_t len){
+
+	OpenFile *of = get_handle(h);
+	if(of == NULL) return FAT_EBADF;
+
+	lock_file(of, 1);
+	ssize_t n = write_locked(of, buf, len);
+	unlock_file(of);
+	return n;
+}